@@ -2,16 +2,23 @@
 #define MEMORY_H_INCLUDE
 
 #include <string.h>
+#include <sys/mman.h>
 
 #define DEFAULT_ALIGNMENT (2*sizeof(void *))
+// NOTE(dgl): reserved arenas commit memory in steps of this size
+#define MEM_COMMIT_GRANULARITY (64*1024)
 
 typedef usize Mem_Index;
 
 typedef struct Mem_Arena {
     uint8 *base;
-    Mem_Index size;
+    Mem_Index size; // NOTE(dgl): reserved address range for reserved arenas
+    Mem_Index commit_size;
     Mem_Index curr_offset;
     Mem_Index prev_offset;
+    // NOTE(dgl): everything after this offset was never handed out and is still zero
+    Mem_Index dirty_offset;
+    bool32 is_reserved;
     char *dbg_name;
 } Mem_Arena;
 
@@ -22,6 +29,8 @@ typedef struct Mem_Temp_Arena {
 } Mem_Temp_Arena;
 
 internal void mem_arena_init(Mem_Arena *arena, uint8 *base, Mem_Index size, char *dbg_name);
+internal bool32 mem_arena_reserve(Mem_Arena *arena, void *base_address, Mem_Index reserve_size, char *dbg_name);
+internal void mem_arena_release(Mem_Arena *arena);
 #define mem_arena_push_struct(arena, type) (type *)mem_arena_alloc_align(arena, sizeof(type), DEFAULT_ALIGNMENT)
 #define mem_arena_push_array(arena, type, count) (type *)mem_arena_alloc_align(arena, (count)*sizeof(type), DEFAULT_ALIGNMENT)
 #define mem_arena_push(arena, size) mem_arena_alloc_align(arena, size, DEFAULT_ALIGNMENT)
@@ -55,12 +64,78 @@ _align_forward_uintptr(uintptr base, usize align) {
 internal void
 mem_arena_init(Mem_Arena *arena, uint8 *base, Mem_Index size, char *dbg_name) {
     arena->size = size;
+    arena->commit_size = size;
     arena->base = base;
     arena->curr_offset = 0;
     arena->prev_offset = 0;
+    // NOTE(dgl): we do not know anything about the memory we got, therefore everything is dirty
+    arena->dirty_offset = size;
+    arena->is_reserved = false;
     arena->dbg_name = dbg_name;
 }
 
+// NOTE(dgl): reserves only the address range. The memory is committed on demand
+// when allocating and returned to the os on free_all. The base_address is only a hint.
+internal bool32
+mem_arena_reserve(Mem_Arena *arena, void *base_address, Mem_Index reserve_size, char *dbg_name) {
+    bool32 result = false;
+    reserve_size = cast(Mem_Index, _align_forward_uintptr(reserve_size, MEM_COMMIT_GRANULARITY));
+
+    void *base = mmap(base_address, reserve_size, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (base != MAP_FAILED) {
+        mem_arena_init(arena, cast(uint8 *, base), reserve_size, dbg_name);
+        arena->commit_size = 0;
+        arena->dirty_offset = 0;
+        arena->is_reserved = true;
+        result = true;
+    } else {
+        LOG("%s: failed to reserve %lu bytes", dbg_name, reserve_size);
+    }
+
+    return(result);
+}
+
+internal void
+mem_arena_release(Mem_Arena *arena) {
+    assert(arena->is_reserved, "Only reserved arenas can be released");
+    munmap(arena->base, arena->size);
+    arena->base = 0;
+    arena->size = 0;
+    arena->commit_size = 0;
+    arena->curr_offset = 0;
+    arena->prev_offset = 0;
+    arena->dirty_offset = 0;
+}
+
+// NOTE(dgl): makes sure the memory up to end_offset is usable.
+internal void
+_mem_arena_commit(Mem_Arena *arena, Mem_Index end_offset) {
+    assert(end_offset <= arena->size, "Arena overflow. Cannot allocate size");
+
+    if (end_offset > arena->commit_size) {
+        assert(arena->is_reserved, "Arena overflow. Cannot commit memory of a fixed arena");
+
+        Mem_Index new_commit_size = cast(Mem_Index, _align_forward_uintptr(end_offset, MEM_COMMIT_GRANULARITY));
+        new_commit_size = min(new_commit_size, arena->size);
+        int err = mprotect(arena->base + arena->commit_size, new_commit_size - arena->commit_size, PROT_READ|PROT_WRITE);
+        assert(err == 0, "%s: failed to commit memory", arena->dbg_name);
+
+        LOG_DEBUG("%s: committed memory from %lu to %lu bytes", arena->dbg_name, arena->commit_size, new_commit_size);
+        arena->commit_size = new_commit_size;
+    }
+}
+
+// NOTE(dgl): zeroes only the part of the range that was handed out before.
+internal void
+_mem_arena_zero(Mem_Arena *arena, Mem_Index offset, Mem_Index size) {
+    if (offset < arena->dirty_offset) {
+        Mem_Index dirty_size = min(size, arena->dirty_offset - offset);
+        memset(arena->base + offset, 0, dirty_size);
+    }
+
+    arena->dirty_offset = max(arena->dirty_offset, offset + size);
+}
+
 internal void *
 mem_arena_alloc_align(Mem_Arena *arena, Mem_Index size, usize align) {
     uintptr curr_ptr = cast(uintptr, arena->base + arena->curr_offset);
@@ -69,16 +144,14 @@ mem_arena_alloc_align(Mem_Arena *arena, Mem_Index size, usize align) {
     Mem_Index offset = cast(Mem_Index, new_ptr - cast(uintptr, arena->base)); // revert back to relative offset
 
     LOG_DEBUG("%s: allocating memory %lu bytes (%lu left)", arena->dbg_name, size, arena->size - (offset+size));
-    // TODO(dgl): make a proper memory check here and allocate more memory from the os
-    assert((offset + size) <= arena->size, "Arena overflow. Cannot allocate size");
+    _mem_arena_commit(arena, offset + size);
 
     void *result = arena->base + offset;
     arena->prev_offset = offset;
     arena->curr_offset = offset + size;
 
-
     // Zero new memory by default (we do not zero the memory on init or free_all)
-    memset(result, 0, size);
+    _mem_arena_zero(arena, offset, size);
 
     return(result);
 }
@@ -92,12 +165,11 @@ mem_arena_resize_align(Mem_Arena *arena, uint8 *current_base, Mem_Index current_
         result = current_base;
     }
     else if(arena->base + arena->prev_offset == current_base) {
-        // TODO(dgl): make a proper memory check here and allocate more memory from the os
-        assert((arena->prev_offset + new_size) <= arena->size, "Arena overflow. Cannot allocate new size");
+        _mem_arena_commit(arena, arena->prev_offset + new_size);
         arena->curr_offset = arena->prev_offset + new_size;
         if (new_size > current_size) {
             // Zero the newly allocated memory
-            memset(arena->base + arena->prev_offset + current_size, 0, new_size - current_size);
+            _mem_arena_zero(arena, arena->prev_offset + current_size, new_size - current_size);
         }
         result = current_base;
         LOG_DEBUG("%s: re-allocating memory from %lu to %lu bytes (%lu left)", arena->dbg_name, current_size, new_size, arena->size - arena->curr_offset);
@@ -118,6 +190,13 @@ internal void
 mem_arena_free_all(Mem_Arena *arena) {
     arena->curr_offset = 0;
     arena->prev_offset = 0;
+
+    if (arena->is_reserved && arena->commit_size > 0) {
+        // NOTE(dgl): the pages stay committed, but the os drops them and hands out
+        // zeroed pages on the next access.
+        madvise(arena->base, arena->commit_size, MADV_DONTNEED);
+        arena->dirty_offset = 0;
+    }
 }
 
 internal Mem_Temp_Arena
@@ -43,7 +43,7 @@ internal inline char *
 string_to_c_str(Mem_Arena *arena, String s) {
     assert(s.text != 0, "String text is not defined");
 
-    char *text = mem_arena_push_array(arena, char, s.length);
+    char *text = mem_arena_push_array(arena, char, s.length + 1);
     string_copy(s.text, s.length, text, s.length);
     text[s.length] = 0;
 
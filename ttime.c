@@ -10,6 +10,10 @@ We can have one line per time entry and multiple columns devided by |. After the
 Example:
 2022-03-08T01:38:00+00:00 | 2022-03-08T01:38:00+00:00 | taskID (-1 if no task specified) | other annotations
 
+An active entry has no end time. We write spaces with the width of the end time (yyyy-mm-ddThh:mm:ss+hh:mm:ss)
+instead, so stopping the entry only has to overwrite the spaces:
+2022-03-08T01:38:00+00:00:00 |                              | -1 | other annotations
+
 TODO(dgl):
     - report error when last line empty
     - Better printing (log vs output)
@@ -17,15 +21,126 @@ TODO(dgl):
 Usage:
     ttime <flags> [command] [command args]
 
+Report:
+    ttime report [yes|w|lastw|m|lastm|yea|lasty] [--sort=begin|duration|task|tag] [filter]
+    ttime report <from> [<to>] reports a custom range. The dates are yyyy-mm-dd (the whole day is
+    included) or yyyy-mm-ddThh[:mm[:ss]][+|-]hh[:mm[:ss]]. Without <to> the range ends now.
+    Entries are grouped by day if they are sorted by begin, otherwise every line has its date.
+        ttime report 2022-01-01 2022-03-31 --sort=duration @work
+    The filter combines tags with and, or, not and parentheses. Adjacent tags are or'ed:
+        ttime report m @work +lorch                 entries with @work or +lorch
+        ttime report m '(+a or +b) and not @home'
+    --by=@context|+project|task prints one line per group with the entry count, hours and the first
+    and last entry instead of the entries. An entry with several tags is counted in each group.
+        ttime report lastm --by=+project @work
+
+Concurrency:
+    Writers (start, stop, continue) hold an exclusive flock on the time file. Readers never lock.
+    They remember the inode and change time of the file they read and retry if a writer renamed
+    a new file into place (or changed the file in place and the reader failed to parse it).
+
+Batch:
+    ttime batch [file] reads one command per line from the file (or stdin) and runs all of them on
+    one parsed copy of the time file, which is written once at the end. A line can start with a
+    timestamp which is used as the current time for this command:
+        2022-03-08T09:00:00+01:00:00 start -t 12 meeting @work
+        2022-03-08T10:30:00+01:00:00 stop
+        report w @work
+
+Server:
+    ttime serve keeps the parsed time file in memory and answers commands on the unix socket
+    <time file>.sock. If the socket exists, start, stop, continue and report send their arguments
+    to the server and print its answer instead of reading the file themselves. The server watches
+    the time file and reloads it if someone else changed it. Commands with -p, -s or -i read the
+    file themselves, -j is passed on to the server.
+
+Index:
+    ttime -i report creates the sidecar <time file>.idx with one binary record per entry (offset,
+    begin/end, task id and a bitset of the tags). Once it exists, reports read the records instead
+    of parsing the text and start, stop and continue update it. Without -i reports of up to a
+    month of an ordered file seek the range in the text instead. Only a current index can tell
+    that the file is ordered, without one the whole file is parsed. The index stores the size,
+    modification time, inode and a hash of the time file. If they match only the last line is
+    hashed. If the file was changed by someone else the next report checks the hash of the
+    content up to the last indexed line. If it did not change only the tail of the file is parsed
+    again, otherwise the index is rebuilt.
+
+Binary:
+    Time files ending with .ttb (ttime -f time.ttb ...) store fixed size records (begin/end epoch,
+    timezone offsets, task id and a reference to the annotation) followed by a pool of the
+    annotations. import stores every distinct annotation once, start appends a new annotation
+    without searching the pool. All commands work on both formats.
+        ttime -f time.ttb import time.txt   copies the entries of time.txt into the new time.ttb
+        ttime -f time.ttb export time.txt   copies the entries of time.ttb into the new time.txt
+    The target of import/export must be empty or new. Comments of text files are not kept.
+
+Flags:
+    -f <file>   use this time file (default ./time.txt, then ~/time.txt)
+    -p          prefault the whole mapped file before a report
+    -s          stream the file in chunks for reports (bounded memory)
+    -j <n>      parse and sort the entries of reports with n threads (default: all cores)
+    -i          create and use the index <time file>.idx for reports
+
 ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~*/
+#define _GNU_SOURCE // NOTE(dgl): copy_file_range
 #define DEBUG_TOKENIZER_PREVIEW 20
 #define MAX_FILENAME_SIZE 4096
 // NOTE(dgl): used to calculate about how much memory we have to allocate for our
 // entry buffer.
 #define AVERAGE_CHARS_PER_LINE 120
-
-// TODO(dgl): @temporary
-#define MAX_TAGS 5
+// NOTE(dgl): block size of the tail reader. We read backwards in blocks of this size
+// until we find the last entry.
+#define TAIL_BLOCK_SIZE kilobytes(4)
+// NOTE(dgl): length of yyyy-mm-ddThh:mm:ss+hh:mm:ss. This is the format we write.
+#define DATETIME_CANONICAL_LENGTH 28
+// NOTE(dgl): chunk size for streaming reports. Lines longer than this grow the chunk.
+#define REPORT_CHUNK_SIZE kilobytes(64)
+// NOTE(dgl): number of entry begins the report converts to epochs at once
+#define EPOCH_BATCH_SIZE 256
+// NOTE(dgl): smaller files are not worth a thread
+#define PARSE_SHARD_MIN_SIZE megabytes(1)
+#define PARSE_SHARD_RESERVE_SIZE gigabytes(16)
+#define MAX_PARSE_THREADS 64
+// NOTE(dgl): smaller files are parsed completely
+#define RANGE_SEEK_MIN_SIZE kilobytes(64)
+// NOTE(dgl): buffer size if we have to copy the unchanged part of a file through userspace
+#define COPY_BUFFER_SIZE kilobytes(64)
+// NOTE(dgl): how often a reader retries if a writer replaced the file while reading
+#define FILE_READ_RETRIES 5
+// NOTE(dgl): max size of a request to the server (all args)
+#define SERVE_REQUEST_SIZE kilobytes(16)
+// NOTE(dgl): a client which does not send or read within this time is dropped
+#define SERVE_CLIENT_TIMEOUT_SECONDS 2
+// NOTE(dgl): number of structural positions the scanner keeps before the parser consumes them
+#define STRUCTURAL_INDEX_SIZE 4096
+// NOTE(dgl): the radix sort uses digits up to SORT_MAX_DIGIT_BITS bits (the histogram fits into L1)
+#define SORT_MAX_DIGIT_BITS 11
+// NOTE(dgl): insertion sort for up to SORT_INSERTION_MAX_COUNT entries or if at most one of
+// SORT_NEARLY_SORTED_RATIO entries is out of order (up to SORT_INSERTION_MOVES moves per entry)
+#define SORT_INSERTION_MAX_COUNT 64
+#define SORT_NEARLY_SORTED_RATIO 8
+#define SORT_INSERTION_MOVES 16
+// NOTE(dgl): the radix sort uses one thread per SORT_PARALLEL_MIN_COUNT entries. The value is
+// provisional, the scaling was only measured on a single core (see sort_bench).
+#define SORT_PARALLEL_MIN_COUNT 262144
+#define MAX_SORT_THREADS 64
+// NOTE(dgl): initial size of the hash table of the tag dictionary
+#define TAG_DICTIONARY_MIN_SLOTS 64
+// NOTE(dgl): the index interns at most INDEX_MAX_TAGS tags (one bit per tag in a record)
+#define INDEX_MAX_TAGS 64
+#define INDEX_TAG_SIZE 32
+#define INDEX_MAGIC 0x58495454 // NOTE(dgl): "TTIX"
+#define INDEX_VERSION 2
+// NOTE(dgl): without -i a report of an ordered file up to this range uses range_seek instead of
+// an existing index. It only parses the window, a stale index would have to be updated first.
+#define INDEX_NARROW_RANGE_SECONDS (31*24*60*60)
+// NOTE(dgl): binary time files (.ttb) reserve at least BINARY_MIN_CAPACITY free records
+#define BINARY_MIN_CAPACITY 1024
+#define BINARY_MAGIC 0x31425454 // NOTE(dgl): "TTB1"
+#define BINARY_VERSION 2
+// NOTE(dgl): filters with up to FILTER_TRUTH_TABLE_MAX_TAGS distinct tags are evaluated with a
+// table of the results of all combinations of their tags
+#define FILTER_TRUTH_TABLE_MAX_TAGS 12
 
 #include <stdio.h>
 #include <time.h>
@@ -37,6 +152,16 @@ Usage:
 #include <sys/ioctl.h>
 #include <errno.h>
 #include <string.h>
+#include <sys/uio.h>
+#include <linux/fs.h>
+#include <sys/file.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <pthread.h>
 #include <x86intrin.h>
 #include <stdarg.h>
 
@@ -66,7 +191,7 @@ Usage:
 
 
 typedef struct Sort_Entry {
-    uint32 sort_key;
+    uint64 sort_key;
     int32 index;
 } Sort_Entry;
 
@@ -96,23 +221,31 @@ typedef struct {
     int32 offset_sign;
 } Datetime;
 
+// NOTE(dgl): positions of the structural characters (newline, divider and the first slash of a
+// comment) of the input. The scanner fills it block by block while the parser consumes it.
+typedef struct {
+    char   *base;
+    usize   count;
+    usize   scanned; // NOTE(dgl): bytes of the input that were already scanned
+    usize  *positions; // NOTE(dgl): offsets from base
+    usize   position_count;
+    usize   position_cursor;
+} Structural_Index;
+
 typedef struct {
     String  input;
 
-    int32   column;
-    int32   line;
+    // NOTE(dgl): line numbers are only calculated if we report an error. base is the beginning
+    // of the buffer and base_line its line number.
+    char   *base;
+    int32   base_line;
+
+    Structural_Index *structurals;
 
     bool32  has_error;
     char   error_msg[256];
 } Tokenizer;
 
-typedef struct {
-    usize   begin; // NOTE(dgl): epoch of begin
-    uintptr buffer_pos;
-    int32   line;
-    usize   length;
-} EntryMeta;
-
 typedef struct {
     Datetime   begin;
     Datetime   end;
@@ -127,6 +260,23 @@ typedef struct {
     bool32  exists;
 } File_Stats;
 
+// NOTE(dgl): identifies the version of the file a reader has seen. Writers replace the file
+// with a rename (new inode) or append/patch in place (new change time).
+typedef struct {
+    dev_t            device;
+    ino_t            inode;
+    struct timespec  change_time;
+} File_Generation;
+
+typedef enum {
+    File_Changed_Replaced = 0x1 << 0,
+    File_Changed_Modified = 0x1 << 1,
+} File_Changed_Flags;
+
+typedef struct {
+    int fd;
+} File_Lock;
+
 
 typedef enum {
     Command_Type_Noop,
@@ -135,9 +285,14 @@ typedef enum {
     Command_Type_Continue,
     Command_Type_Report,
     Command_Type_CSV,
+    Command_Type_Batch,
+    Command_Type_Serve,
+    Command_Type_Import,
+    Command_Type_Export,
 #if DEBUG
     Command_Type_Generate,
     Command_Type_Test,
+    Command_Type_Bench,
 #endif
 } Command_Type;
 
@@ -159,12 +314,53 @@ typedef enum {
     Report_Type_Custom,
 } Report_Type;
 
+typedef enum {
+    Report_Sort_Begin,
+    Report_Sort_Duration,
+    Report_Sort_Task,
+    Report_Sort_Tag, // NOTE(dgl): by the first tag of the annotation
+} Report_Sort;
+
+typedef enum {
+    Report_Group_None,
+    Report_Group_Context, // NOTE(dgl): @ tags
+    Report_Group_Project, // NOTE(dgl): + tags
+    Report_Group_Task,
+} Report_Group_By;
+
+typedef enum {
+    Filter_Op_Tag,
+    Filter_Op_Not,
+    Filter_Op_And,
+    Filter_Op_Or,
+} Filter_Op;
+
+typedef struct {
+    Filter_Op  op;
+    uint32     slot; // NOTE(dgl): tag of Filter_Op_Tag
+} Filter_Code;
+
+// NOTE(dgl): compiled tag filter. The distinct tags of the expression are the slots. The code
+// is in postfix order and works on a stack of booleans. The input of an evaluation is
+// slot_bits, bit slot is set if the entry has the tag. An empty filter matches every entry.
+typedef struct {
+    Filter_Code *code;
+    uint32       code_count;
+    String      *tags; // NOTE(dgl): by slot
+    uint32       tag_count;
+    uint64      *slot_bits;
+    uint32       slot_word_count;
+    uint8       *stack;
+    uint8       *truth; // NOTE(dgl): result for every value of slot_bits[0], 0 if there are too many tags
+} Report_Filter;
+
 typedef struct {
-    Report_Type type;
-    Datetime    from;
-    Datetime    to;
-    String      filter[MAX_TAGS];
-    int         filter_count;
+    Report_Type     type;
+    Report_Sort     sort;
+    Report_Group_By group_by;
+    Datetime        from;
+    Datetime        to;
+    Report_Filter   filter;
 } Command_Report;
 
 typedef struct {
@@ -172,17 +368,36 @@ typedef struct {
     bool32         heading;
 } Command_CSV;
 
+typedef struct {
+    String  input; // NOTE(dgl): file with the commands (stdin if empty)
+} Command_Batch;
+
+typedef struct {
+    String  filename; // NOTE(dgl): import from/export to this file
+} Command_Convert;
+
+typedef enum {
+    Input_Populate = 0x1 << 0, // NOTE(dgl): prefault the whole mapping (MAP_POPULATE)
+    Input_Stream   = 0x1 << 1, // NOTE(dgl): read the file in chunks, memory does not depend on the file size
+    Input_Index    = 0x1 << 2, // NOTE(dgl): create the index if it does not exist
+} Input_Flags;
+
 typedef struct {
     Mem_Arena     *arena;
     Command_Type  command_type;
     bool32        is_valid;
     File_Stats    file;
+    int32         input_flags;
+    uint32        thread_count; // NOTE(dgl): 0 uses all cores
     int32         window_columns;
     int32         window_rows;
+    Datetime      now; // NOTE(dgl): time of the command (batch commands can set it)
     union {
         Command_Start  start;
         Command_Report report;
         Command_CSV    csv;
+        Command_Batch  batch;
+        Command_Convert convert;
     };
 } Commandline;
 
@@ -353,6 +568,88 @@ get_file_stats(Mem_Arena *arena, String filename) {
     return result;
 }
 
+internal File_Generation
+file_generation_from_stat(struct stat *file_stat) {
+    File_Generation result = {};
+    result.device = file_stat->st_dev;
+    result.inode = file_stat->st_ino;
+    result.change_time = file_stat->st_ctim;
+    return result;
+}
+
+// NOTE(dgl): compares the generation a reader has seen with the file currently at the path.
+internal int32
+file_generation_changed(File_Stats *file, File_Generation *generation) {
+    int32 result = 0;
+
+    struct stat file_stat = {};
+    if (stat(file->filename.text, &file_stat) == 0) {
+        File_Generation current = file_generation_from_stat(&file_stat);
+        if (current.device != generation->device || current.inode != generation->inode) {
+            result |= File_Changed_Replaced;
+        } else if (current.change_time.tv_sec != generation->change_time.tv_sec ||
+                   current.change_time.tv_nsec != generation->change_time.tv_nsec) {
+            result |= File_Changed_Modified;
+        }
+    } else {
+        result |= File_Changed_Replaced;
+    }
+
+    return result;
+}
+
+// NOTE(dgl): takes the writer lock of the file. Another writer can replace the file with
+// a rename while we wait for the lock. In that case we hold the lock of the old inode and
+// have to try again with the file which is now at the path.
+internal File_Lock
+file_lock(Mem_Arena *arena, File_Stats *file) {
+    File_Lock result = {};
+    result.fd = -1;
+
+    for (;;) {
+        int fd = open(file->filename.text, O_RDWR);
+        if (fd < 0) {
+            fd = open(file->filename.text, O_RDONLY);
+        }
+
+        if (fd < 0) {
+            LOG("Could not open file: %s", string_to_c_str(arena, file->filename));
+            break;
+        }
+
+        if (flock(fd, LOCK_EX) != 0) {
+            LOG("Failed to lock file %s with error: %d", string_to_c_str(arena, file->filename), errno);
+            close(fd);
+            break;
+        }
+
+        struct stat locked_stat = {};
+        struct stat path_stat = {};
+        fstat(fd, &locked_stat);
+        if (stat(file->filename.text, &path_stat) == 0 &&
+            locked_stat.st_dev == path_stat.st_dev &&
+            locked_stat.st_ino == path_stat.st_ino) {
+            file->filesize = cast(usize, locked_stat.st_size);
+            result.fd = fd;
+            break;
+        }
+
+        LOG_DEBUG("File was replaced while waiting for the lock. Retrying");
+        close(fd);
+    }
+
+    return result;
+}
+
+internal void
+file_unlock(File_Lock *lock) {
+    if (lock->fd >= 0) {
+        // NOTE(dgl): closing the file releases the lock
+        close(lock->fd);
+        lock->fd = -1;
+    }
+}
+
 internal void
 read_entire_file(Mem_Arena *temp_arena, File_Stats *file, Buffer *buffer) {
     int fd = open(file->filename.text, O_RDONLY);
@@ -375,9 +672,170 @@ read_entire_file(Mem_Arena *temp_arena, File_Stats *file, Buffer *buffer) {
     }
 }
 
-// NOTE(dgl): appends the different buffers.
+// NOTE(dgl): maps the file read-only into memory. The buffer points directly into the
+// mapping, therefore nothing is copied and the file size is not limited by our arenas.
+// Returns false if the file could not be mapped (e.g. empty files).
+internal bool32
+map_entire_file(Mem_Arena *arena, File_Stats *file, Buffer *buffer, int32 flags, File_Generation *generation) {
+    bool32 result = false;
+
+    int fd = open(file->filename.text, O_RDONLY);
+    if (fd >= 0) {
+        struct stat file_stat = {};
+        fstat(fd, &file_stat);
+        usize filesize = cast(usize, file_stat.st_size);
+        *generation = file_generation_from_stat(&file_stat);
+
+        if (filesize > 0) {
+            int map_flags = MAP_PRIVATE;
+            if (flags & Input_Populate) {
+                map_flags |= MAP_POPULATE;
+            }
+
+            void *data = mmap(0, filesize, PROT_READ, map_flags, fd, 0);
+            if (data != MAP_FAILED) {
+                madvise(data, filesize, MADV_SEQUENTIAL);
+                buffer->data = data;
+                buffer->data_count = filesize;
+                buffer->cap = filesize;
+                result = true;
+            } else {
+                LOG("Failed to map file %s with error: %d", string_to_c_str(arena, file->filename), errno);
+            }
+        }
+        close(fd);
+    } else {
+        LOG("Could not open file: %s", string_to_c_str(arena, file->filename));
+    }
+
+    return result;
+}
+
 internal void
-write_entire_file(Mem_Arena *arena, File_Stats *file, int buffer_count, ...) {
+unmap_file(Buffer *buffer) {
+    if (buffer->data) {
+        munmap(buffer->data, buffer->cap);
+        buffer->data = 0;
+        buffer->data_count = 0;
+        buffer->cap = 0;
+    }
+}
+
+// NOTE(dgl): appends the buffers to the end of the file with a single write. The existing
+// content is never touched.
+internal void
+append_to_file(Mem_Arena *arena, File_Stats *file, int buffer_count, ...) {
+    struct iovec parts[8];
+    assert(buffer_count <= array_count(parts), "Too many buffers. Increase the iovec count.");
+
+    usize total = 0;
+    va_list buffers;
+    va_start(buffers, buffer_count);
+    for (int index = 0; index < buffer_count; ++index) {
+        Buffer *buffer = va_arg(buffers, Buffer *);
+        parts[index].iov_base = buffer->data;
+        parts[index].iov_len = buffer->data_count;
+        total += buffer->data_count;
+    }
+    va_end(buffers);
+
+    int fd = open(file->filename.text, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd >= 0) {
+        ssize_t res = writev(fd, parts, buffer_count);
+        if (res < 0) {
+            LOG("Failed appending to file %s with error: %d", string_to_c_str(arena, file->filename), errno);
+        } else {
+            LOG_DEBUG("Appended %ld bytes of %lu bytes to %s", res, total, string_to_c_str(arena, file->filename));
+        }
+        close(fd);
+    } else {
+        LOG("Could not open file: %s", string_to_c_str(arena, file->filename));
+    }
+}
+
+// NOTE(dgl): overwrites the bytes at offset with the buffer. The file size does not change.
+internal bool32
+patch_file(Mem_Arena *arena, File_Stats *file, usize offset, Buffer *buffer) {
+    bool32 result = false;
+
+    int fd = open(file->filename.text, O_WRONLY);
+    if (fd >= 0) {
+        ssize_t res = pwrite(fd, buffer->data, buffer->data_count, cast(off_t, offset));
+        if (res == cast(ssize_t, buffer->data_count)) {
+            LOG_DEBUG("Patched %ld bytes at offset %lu in %s", res, offset, string_to_c_str(arena, file->filename));
+            result = true;
+        } else {
+            LOG("Failed patching file %s with error: %d", string_to_c_str(arena, file->filename), errno);
+        }
+        close(fd);
+    } else {
+        LOG("Could not open file: %s", string_to_c_str(arena, file->filename));
+    }
+
+    return result;
+}
+
+// NOTE(dgl): copies the first size bytes from src to dest. Everything is done in the kernel if
+// possible. Filesystems with reflinks (btrfs, xfs) clone the whole blocks with FICLONERANGE, which
+// only touches metadata. The rest goes through copy_file_range and only if both fail we copy
+// through a userspace buffer.
+internal bool32
+copy_file_prefix(Mem_Arena *temp_arena, int src_fd, int dest_fd, usize size) {
+    usize copied = 0;
+
+    struct stat file_stat = {};
+    fstat(src_fd, &file_stat);
+    usize block_size = file_stat.st_blksize > 0 ? cast(usize, file_stat.st_blksize) : 4096;
+    usize clone_size = (size / block_size) * block_size;
+
+    if (clone_size > 0) {
+        struct file_clone_range range = {};
+        range.src_fd = src_fd;
+        range.src_offset = 0;
+        range.src_length = clone_size;
+        range.dest_offset = 0;
+        if (ioctl(dest_fd, FICLONERANGE, &range) == 0) {
+            copied = clone_size;
+            LOG_DEBUG("Cloned %lu bytes", clone_size);
+        }
+    }
+
+    while (copied < size) {
+        loff_t src_offset = cast(loff_t, copied);
+        loff_t dest_offset = cast(loff_t, copied);
+        ssize_t res = copy_file_range(src_fd, &src_offset, dest_fd, &dest_offset, size - copied, 0);
+        if (res <= 0) {
+            break;
+        }
+        copied += cast(usize, res);
+    }
+
+    if (copied < size) {
+        LOG_DEBUG("Kernel copy not available (%d). Copying %lu bytes through userspace", errno, size - copied);
+        Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+        {
+            uint8 *copy_buffer = mem_arena_push_array(tmp_arena.arena, uint8, COPY_BUFFER_SIZE);
+            while (copied < size) {
+                usize chunk = min(size - copied, cast(usize, COPY_BUFFER_SIZE));
+                ssize_t res = pread(src_fd, copy_buffer, chunk, cast(off_t, copied));
+                if (res <= 0 || pwrite(dest_fd, copy_buffer, cast(usize, res), cast(off_t, copied)) != res) {
+                    break;
+                }
+                copied += cast(usize, res);
+            }
+        }
+        mem_arena_end_temp(tmp_arena);
+    }
+
+    bool32 result = (copied == size);
+    return result;
+}
+
+// NOTE(dgl): replaces the file with its first keep_size bytes followed by the buffers. The new
+// content is written to a temporary file which replaces the file afterwards. The unchanged
+// prefix never goes through userspace (see copy_file_prefix).
+internal void
+rewrite_file(Mem_Arena *arena, File_Stats *file, usize keep_size, Buffer *buffers, int buffer_count) {
     char tmp_filename[MAX_FILENAME_SIZE];
     assert(file->filename.length + 2 < MAX_FILENAME_SIZE, "Filename too long. Increase MAX_FILENAME_SIZE.");
     string_copy(file->filename.text, file->filename.length, tmp_filename, MAX_FILENAME_SIZE);
@@ -385,59 +843,103 @@ write_entire_file(Mem_Arena *arena, File_Stats *file, int buffer_count, ...) {
     tmp_filename[file->filename.length] = '~';
     tmp_filename[file->filename.length + 1] = 0;
 
-    int fd = open(tmp_filename, O_WRONLY | O_CREAT, 0644);
-    if (fd) {
-        va_list buffers;
-        va_start(buffers, buffer_count);
+    bool32 success = false;
+    int fd = open(tmp_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        success = true;
+        if (keep_size > 0) {
+            int src_fd = open(file->filename.text, O_RDONLY);
+            if (src_fd >= 0) {
+                success = copy_file_prefix(arena, src_fd, fd, keep_size);
+                close(src_fd);
+            } else {
+                success = false;
+            }
+
+            if (!success) {
+                LOG("Failed to copy the content of %s", string_to_c_str(arena, file->filename));
+            }
+        }
 
-        for (int index = 0; index < buffer_count; ++index) {
-            Buffer *buffer = va_arg(buffers, Buffer *);
+        lseek(fd, cast(off_t, keep_size), SEEK_SET);
+        for (int index = 0; success && index < buffer_count; ++index) {
+            Buffer *buffer = buffers + index;
             ssize_t res = write(fd, buffer->data, buffer->data_count);
             if (res < 0) {
                 LOG("Failed writing to file %s with error: %d", tmp_filename, errno);
+                success = false;
             } else {
                 LOG_DEBUG("Written %ld bytes of %ld bytes to %s", res, buffer->data_count, tmp_filename);
             }
         }
+        close(fd);
+    } else {
+        LOG("Could not open file: %s", tmp_filename);
+    }
 
-        va_end(buffers);
+    if (success) {
+        if(rename(tmp_filename, file->filename.text) != 0) {
+            LOG("Failed to move content from temporary file %s to %s", tmp_filename, string_to_c_str(arena, file->filename));
+        }
+    } else {
+        unlink(tmp_filename);
     }
-    close(fd);
+}
 
-    if(rename(tmp_filename, file->filename.text) != 0) {
-        LOG("Failed to move content from temporary file %s to %s", tmp_filename, string_to_c_str(arena, file->filename));
+// NOTE(dgl): appends the different buffers.
+internal void
+write_entire_file(Mem_Arena *arena, File_Stats *file, int buffer_count, ...) {
+    Buffer parts[8];
+    assert(buffer_count <= array_count(parts), "Too many buffers. Increase the buffer count.");
+
+    va_list buffers;
+    va_start(buffers, buffer_count);
+    for (int index = 0; index < buffer_count; ++index) {
+        parts[index] = *va_arg(buffers, Buffer *);
     }
+    va_end(buffers);
+
+    rewrite_file(arena, file, 0, parts, buffer_count);
+}
+
+internal void
+append_datetime(String_Builder *builder, Datetime *datetime) {
+    string_append(builder, "%04d-%02d-%02dT%02d:%02d:%02d%c%02d:%02d:%02d",
+                           datetime->year,
+                           datetime->month,
+                           datetime->day,
+                           datetime->hour,
+                           datetime->minute,
+                           datetime->second,
+                           datetime->offset_sign ? '-' : '+',
+                           datetime->offset_hour,
+                           datetime->offset_minute,
+                           datetime->offset_second);
+}
+
+internal Buffer
+datetime_to_buffer(Mem_Arena *arena, Datetime *datetime) {
+    String_Builder builder = string_builder_init(arena, sizeof(char) * (DATETIME_CANONICAL_LENGTH + 1));
+    append_datetime(&builder, datetime);
+
+    String string = string_builder_to_string(&builder);
+    Buffer result = string_to_buffer(&string);
+
+    return (result);
 }
 
 internal Buffer
 entry_to_buffer(Mem_Arena *arena, Entry *entry) {
     String_Builder builder = string_builder_init(arena, sizeof(char) * 80);
-    string_append(&builder, "%04d-%02d-%02dT%02d:%02d:%02d%c%02d:%02d:%02d | ",
-                           entry->begin.year,
-                           entry->begin.month,
-                           entry->begin.day,
-                           entry->begin.hour,
-                           entry->begin.minute,
-                           entry->begin.second,
-                           entry->begin.offset_sign ? '-' : '+',
-                           entry->begin.offset_hour,
-                           entry->begin.offset_minute,
-                           entry->begin.offset_second);
+    append_datetime(&builder, &entry->begin);
+    string_append(&builder, " | ");
 
     if (entry->end.year > 0) {
-        string_append(&builder, "%04d-%02d-%02dT%02d:%02d:%02d%c%02d:%02d:%02d | ",
-                               entry->end.year,
-                               entry->end.month,
-                               entry->end.day,
-                               entry->end.hour,
-                               entry->end.minute,
-                               entry->end.second,
-                               entry->end.offset_sign ? '-' : '+',
-                               entry->end.offset_hour,
-                               entry->end.offset_minute,
-                               entry->end.offset_second);
-    } else {
+        append_datetime(&builder, &entry->end);
         string_append(&builder, " | ");
+    } else {
+        // NOTE(dgl): placeholder for the end time. Stop overwrites it in place.
+        string_append(&builder, "%*s | ", DATETIME_CANONICAL_LENGTH, "");
     }
 
     string_append(&builder, "%d | ", entry->task_id);
@@ -454,26 +956,137 @@ entry_to_buffer(Mem_Arena *arena, Entry *entry) {
     return (result);
 }
 
-// NOTE(dgl): Returns 0 if the complete buffer b was merged into buffer a.
-// It buffer b is larger than a, we return the number of the missing bytes.
+//
+// Structural scanner
+// NOTE(dgl): finds newlines, dividers (|) and comments (//) 16 bytes (SSE) or 32 bytes (AVX2)
+// at a time. AVX2 is only used if the cpu supports it. The comment mask compares the block with
+// the block shifted by one byte, therefore the vector loops stop one byte before the end.
+//
+
+global bool32 global_has_avx2;
+
+internal inline void
+structural_push_mask(Structural_Index *index, uint32 mask) {
+    while (mask) {
+        index->positions[index->position_count++] = index->scanned + cast(usize, __builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+}
+
+internal __attribute__((target("avx2"))) void
+structural_scan_avx2(Structural_Index *index) {
+    __m256i newline = _mm256_set1_epi8('\n');
+    __m256i divider = _mm256_set1_epi8('|');
+    __m256i slash = _mm256_set1_epi8('/');
+
+    while (index->scanned + 32 < index->count && index->position_count + 32 <= STRUCTURAL_INDEX_SIZE) {
+        char *data = index->base + index->scanned;
+        __m256i block = _mm256_loadu_si256(cast(__m256i *, data));
+        __m256i next = _mm256_loadu_si256(cast(__m256i *, data + 1));
+
+        __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(block, newline), _mm256_cmpeq_epi8(block, divider));
+        matches = _mm256_or_si256(matches, _mm256_and_si256(_mm256_cmpeq_epi8(block, slash), _mm256_cmpeq_epi8(next, slash)));
+
+        structural_push_mask(index, cast(uint32, _mm256_movemask_epi8(matches)));
+        index->scanned += 32;
+    }
+}
+
+internal void
+structural_scan_sse(Structural_Index *index) {
+    __m128i newline = _mm_set1_epi8('\n');
+    __m128i divider = _mm_set1_epi8('|');
+    __m128i slash = _mm_set1_epi8('/');
+
+    while (index->scanned + 16 < index->count && index->position_count + 16 <= STRUCTURAL_INDEX_SIZE) {
+        char *data = index->base + index->scanned;
+        __m128i block = _mm_loadu_si128(cast(__m128i *, data));
+        __m128i next = _mm_loadu_si128(cast(__m128i *, data + 1));
+
+        __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(block, newline), _mm_cmpeq_epi8(block, divider));
+        matches = _mm_or_si128(matches, _mm_and_si128(_mm_cmpeq_epi8(block, slash), _mm_cmpeq_epi8(next, slash)));
+
+        structural_push_mask(index, cast(uint32, _mm_movemask_epi8(matches)));
+        index->scanned += 16;
+    }
+}
+
+// NOTE(dgl): the index covers the input from begin to end, offsets are relative to base.
+internal void
+structural_index_init(Mem_Arena *arena, Structural_Index *index, char *base, usize begin, usize end) {
+    *index = (Structural_Index){};
+    index->base = base;
+    index->scanned = begin;
+    index->count = end;
+    index->positions = mem_arena_push_array(arena, usize, STRUCTURAL_INDEX_SIZE);
+}
+
+// NOTE(dgl): drops the consumed positions and scans the input until the index is full.
+internal void
+structural_index_fill(Structural_Index *index) {
+    usize unconsumed = index->position_count - index->position_cursor;
+    memmove(index->positions, index->positions + index->position_cursor, unconsumed * sizeof(usize));
+    index->position_count = unconsumed;
+    index->position_cursor = 0;
+
+    if (global_has_avx2) {
+        structural_scan_avx2(index);
+    }
+    structural_scan_sse(index);
+
+    // NOTE(dgl): the last bytes of the input
+    if (index->scanned + 16 >= index->count) {
+        while (index->scanned < index->count && index->position_count < STRUCTURAL_INDEX_SIZE) {
+            char *c = index->base + index->scanned;
+            if (*c == '\n' || *c == '|' || (*c == '/' && index->scanned + 1 < index->count && c[1] == '/')) {
+                index->positions[index->position_count++] = index->scanned;
+            }
+            ++index->scanned;
+        }
+    }
+}
+
+// NOTE(dgl): returns the offset of the next structural character at or after offset, or the
+// input size if there is none. Positions before offset are consumed, therefore the offsets
+// must not go backwards.
 internal usize
-buffer_merge_at(Buffer *a, Buffer *b, usize pos) {
-    assert(pos < a->cap, "Position outside of buffer");
-    usize bytes_to_write = b->data_count;
+structural_next(Structural_Index *index, usize offset) {
+    usize result = index->count;
+
+    for (;;) {
+        while (index->position_cursor < index->position_count && index->positions[index->position_cursor] < offset) {
+            ++index->position_cursor;
+        }
+
+        if (index->position_cursor < index->position_count) {
+            result = index->positions[index->position_cursor];
+            break;
+        }
 
-    if (a->cap - pos < bytes_to_write) {
-        bytes_to_write = cast(usize, a->cap - pos - 1);
+        if (index->scanned >= index->count) {
+            break;
+        }
+        structural_index_fill(index);
     }
 
-    assert(b->data_count >= bytes_to_write, "Cannot write more bytes than available");
+    return result;
+}
 
-    usize missing_bytes = b->data_count - bytes_to_write;
-    string_copy(b->data, bytes_to_write, a->data + pos, a->cap - pos);
-    a->data_count = pos + bytes_to_write;
+internal int32
+count_newlines(char *data, usize count) {
+    int32 result = 0;
 
-    LOG_DEBUG("Buffer does not have enough space. We will only merge partially - left %lu, required %lu, missing %lu", a->cap - pos, b->data_count, missing_bytes);
+    __m128i newline = _mm_set1_epi8('\n');
+    usize cursor = 0;
+    for (; cursor + 16 <= count; cursor += 16) {
+        __m128i block = _mm_loadu_si128(cast(__m128i *, data + cursor));
+        result += __builtin_popcount(cast(uint32, _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline))));
+    }
+    for (; cursor < count; ++cursor) {
+        result += data[cursor] == '\n';
+    }
 
-    return missing_bytes;
+    return result;
 }
 
 //
@@ -488,15 +1101,9 @@ fill_tokenizer(Tokenizer *tokenizer, Buffer *buffer) {
     tokenizer->input.length = buffer->data_count;
     tokenizer->input.cap = buffer->cap;
 
-    tokenizer->line = 1;
-    tokenizer->column = 0;
-}
-
-internal void
-set_tokenizer(Tokenizer *tokenizer, usize offset) {
-    assert(offset < tokenizer->input.cap, "Offset cannot be larger than tokenizer input. Max value: %zu, got: %zu", tokenizer->input.cap, offset);
-    tokenizer->input.data += offset;
-    tokenizer->input.length -= offset;
+    tokenizer->base = buffer->data;
+    tokenizer->base_line = 1;
+    tokenizer->structurals = 0;
 }
 
 internal void
@@ -506,9 +1113,18 @@ token_error(Tokenizer *tokenizer, char *msg) {
     // because after an error all tokens become invalid.
     if (!tokenizer->has_error) {
         tokenizer->has_error = true;
-        LOG_DEBUG("Parsing error at line %d, column %d: %s", tokenizer->line, tokenizer->column + 1, msg);
+
+        usize offset = cast(usize, tokenizer->input.text - tokenizer->base);
+        int32 line = tokenizer->base_line + count_newlines(tokenizer->base, offset);
+        usize line_begin = offset;
+        while (line_begin > 0 && tokenizer->base[line_begin - 1] != '\n') {
+            --line_begin;
+        }
+        int32 column = cast(int32, offset - line_begin);
+
+        LOG_DEBUG("Parsing error at line %d, column %d: %s", line, column + 1, msg);
         // TODO(dgl): can we use the permanent_arena to store this error?
-        stbsp_snprintf(tokenizer->error_msg, array_count(tokenizer->error_msg), "Parsing error at line %d, column %d: %s", tokenizer->line, tokenizer->column + 1, msg);
+        stbsp_snprintf(tokenizer->error_msg, array_count(tokenizer->error_msg), "Parsing error at line %d, column %d: %s", line, column + 1, msg);
     }
 }
 
@@ -519,12 +1135,44 @@ eat_next_character(Tokenizer *tokenizer) {
         // LOG_DEBUG("Eaten character %c (%d)", *tokenizer->input.text, *tokenizer->input.text);
         ++tokenizer->input.data;
         --tokenizer->input.length;
-        ++tokenizer->column;
-        if (*tokenizer->input.text == '\n') {
-            ++tokenizer->line;
-            tokenizer->column = 0;
+    }
+}
+
+internal inline void
+eat_characters_until(Tokenizer *tokenizer, char *end) {
+    if (!tokenizer->has_error) {
+        usize count = cast(usize, end - tokenizer->input.text);
+        assert(count <= tokenizer->input.length, "Cannot eat more characters than available");
+        tokenizer->input.text += count;
+        tokenizer->input.length -= count;
+    }
+}
+
+// NOTE(dgl): returns the position of the next newline or the end of the input. Uses the
+// structural index if the tokenizer has one.
+internal inline char *
+find_next_newline(Tokenizer *tokenizer) {
+    char *result = tokenizer->input.text + tokenizer->input.length;
+
+    if (tokenizer->structurals) {
+        Structural_Index *index = tokenizer->structurals;
+        usize offset = cast(usize, tokenizer->input.text - index->base);
+        usize end = offset + tokenizer->input.length;
+        usize position = structural_next(index, offset);
+        while (position < end && index->base[position] != '\n') {
+            position = structural_next(index, position + 1);
+        }
+        if (position < end) {
+            result = index->base + position;
+        }
+    } else {
+        char *newline = memchr(tokenizer->input.text, '\n', tokenizer->input.length);
+        if (newline) {
+            result = newline;
         }
     }
+
+    return result;
 }
 
 // NOTE(dgl): negative lookahead is possible but be careful!
@@ -566,9 +1214,7 @@ eat_all_whitespace(Tokenizer *tokenizer) {
         if (c == '/') {
             char next_c = peek_character(tokenizer, 1);
             if (next_c == '/') {
-                while(peek_next_character(tokenizer) != '\n' && tokenizer->input.length > 0) {
-                    eat_next_character(tokenizer);
-                }
+                eat_characters_until(tokenizer, find_next_newline(tokenizer));
             } else {
                 return;
             }
@@ -590,14 +1236,10 @@ parse_string_line(Tokenizer *tokenizer) {
     String result = {};
     if (!tokenizer->has_error) {
         char *begin = tokenizer->input.text;
-        char next = peek_next_character(tokenizer);
-        uint32 length = 0;
-        while(!(next == '\n' || next == 0)) {
-            eat_next_character(tokenizer);
-            next = peek_next_character(tokenizer);
-            ++length;
-        }
+        char *end = find_next_newline(tokenizer);
+        eat_characters_until(tokenizer, end);
 
+        usize length = cast(usize, end - begin);
         result.length = length;
         result.cap = length;
         result.text = begin;
@@ -732,9 +1374,59 @@ parse_timezone(Tokenizer *tokenizer) {
     return result;
 }
 
+// NOTE(dgl): decodes the layout entry_to_buffer writes (yyyy-mm-ddThh:mm:ss+hh:mm:ss) with two
+// 16 byte loads (bytes 0-15 and 12-27). The digits are validated and the separators compared
+// with a template, then the digits are gathered in pairs and combined with maddubs.
+// Returns false if the text does not match exactly, the general parser handles it then.
+internal bool32
+parse_datetime_canonical(char *text, Datetime *datetime) {
+    __m128i low = _mm_loadu_si128(cast(__m128i *, text));
+    __m128i high = _mm_loadu_si128(cast(__m128i *, text + 12));
+
+    // NOTE(dgl): 0xFF marks digits, the other bytes must match
+    __m128i low_digits = _mm_setr_epi8(-1, -1, -1, -1, 0, -1, -1, 0, -1, -1, 0, -1, -1, 0, -1, -1);
+    __m128i low_template = _mm_setr_epi8(0, 0, 0, 0, '-', 0, 0, '-', 0, 0, 'T', 0, 0, ':', 0, 0);
+    __m128i high_digits = _mm_setr_epi8(-1, 0, -1, -1, 0, -1, -1, 0, -1, -1, 0, -1, -1, 0, -1, -1);
+    __m128i high_template = _mm_setr_epi8(0, ':', 0, 0, ':', 0, 0, '+', 0, 0, ':', 0, 0, ':', 0, 0);
+    if (text[19] == '-') {
+        high_template = _mm_insert_epi8(high_template, '-', 7);
+    }
+
+    __m128i zero = _mm_set1_epi8('0');
+    __m128i nine = _mm_set1_epi8(9);
+    __m128i low_values = _mm_sub_epi8(low, zero);
+    __m128i high_values = _mm_sub_epi8(high, zero);
+
+    __m128i low_valid = _mm_or_si128(_mm_and_si128(low_digits, _mm_cmpeq_epi8(_mm_max_epu8(low_values, nine), nine)),
+                                     _mm_andnot_si128(low_digits, _mm_cmpeq_epi8(low, low_template)));
+    __m128i high_valid = _mm_or_si128(_mm_and_si128(high_digits, _mm_cmpeq_epi8(_mm_max_epu8(high_values, nine), nine)),
+                                      _mm_andnot_si128(high_digits, _mm_cmpeq_epi8(high, high_template)));
+
+    bool32 result = (_mm_movemask_epi8(_mm_and_si128(low_valid, high_valid)) == 0xFFFF);
+    if (result) {
+        __m128i low_pairs = _mm_shuffle_epi8(low_values, _mm_setr_epi8(0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, -1, -1, -1, -1));
+        __m128i high_pairs = _mm_shuffle_epi8(high_values, _mm_setr_epi8(5, 6, 8, 9, 11, 12, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1));
+        __m128i weights = _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
+        low_pairs = _mm_maddubs_epi16(low_pairs, weights);
+        high_pairs = _mm_maddubs_epi16(high_pairs, weights);
+
+        datetime->year = _mm_extract_epi16(low_pairs, 0) * 100 + _mm_extract_epi16(low_pairs, 1);
+        datetime->month = _mm_extract_epi16(low_pairs, 2);
+        datetime->day = _mm_extract_epi16(low_pairs, 3);
+        datetime->hour = _mm_extract_epi16(low_pairs, 4);
+        datetime->minute = _mm_extract_epi16(low_pairs, 5);
+        datetime->second = _mm_extract_epi16(high_pairs, 0);
+        datetime->offset_sign = text[19] == '-';
+        datetime->offset_hour = _mm_extract_epi16(high_pairs, 1);
+        datetime->offset_minute = _mm_extract_epi16(high_pairs, 2);
+        datetime->offset_second = _mm_extract_epi16(high_pairs, 3);
+    }
+
+    return result;
+}
+
 internal Datetime
-parse_datetime(Tokenizer *tokenizer) {
-    // LOG_DEBUG("Parsing datetime from %.*s", DEBUG_TOKENIZER_PREVIEW, tokenizer->input.text);
+parse_datetime_general(Tokenizer *tokenizer) {
     Datetime result = {};
     Datetime date = parse_date(tokenizer);
 
@@ -762,34 +1454,29 @@ parse_datetime(Tokenizer *tokenizer) {
     return result;
 }
 
-internal EntryMeta
-parse_entry_meta(Tokenizer *tokenizer) {
-    // LOG_DEBUG("Parsing entry meta from %.*s", DEBUG_TOKENIZER_PREVIEW, tokenizer->input.text);
-    EntryMeta result = {};
-
-    eat_all_whitespace(tokenizer);
-    char *pos = tokenizer->input.text;
-    Datetime begin = parse_datetime(tokenizer);
-    parse_string_line(tokenizer);
-
-    char c = peek_next_character(tokenizer);
-    if (c == '\n') {
-        eat_next_character(tokenizer);
-    }
-
-    if (!tokenizer->has_error) {
-        result.begin = datetime_to_epoch(&begin);
-        result.buffer_pos = cast(uintptr, pos);
-        result.line = tokenizer->line;
+internal Datetime
+parse_datetime(Tokenizer *tokenizer) {
+    // LOG_DEBUG("Parsing datetime from %.*s", DEBUG_TOKENIZER_PREVIEW, tokenizer->input.text);
+    Datetime result = {};
 
-        int64 length = tokenizer->input.text - pos;
-        assert(length >= 0, "Invalid entry length");
-        result.length = cast(usize, length);
+    // NOTE(dgl): fast path for the canonical layout. A digit after it means the last field is
+    // longer than two digits, we let the general parser handle it.
+    char *text = tokenizer->input.text;
+    usize length = tokenizer->input.length;
+    if (!tokenizer->has_error &&
+        length >= DATETIME_CANONICAL_LENGTH &&
+        !(length > DATETIME_CANONICAL_LENGTH && text[DATETIME_CANONICAL_LENGTH] >= '0' && text[DATETIME_CANONICAL_LENGTH] <= '9') &&
+        parse_datetime_canonical(text, &result)) {
+        eat_characters_until(tokenizer, text + DATETIME_CANONICAL_LENGTH);
+    } else {
+        result = parse_datetime_general(tokenizer);
     }
 
     return result;
 }
 
+internal void parse_entry_fields(Tokenizer *tokenizer, Entry *entry);
+
 internal Entry
 parse_entry(Tokenizer *tokenizer) {
     // LOG_DEBUG("Parsing entry from %.*s", DEBUG_TOKENIZER_PREVIEW, tokenizer->input.text);
@@ -797,6 +1484,15 @@ parse_entry(Tokenizer *tokenizer) {
 
     eat_all_whitespace(tokenizer);
     result.begin = parse_datetime(tokenizer);
+    parse_entry_fields(tokenizer, &result);
+
+    return result;
+}
+
+// NOTE(dgl): parses everything after the begin of the entry
+internal void
+parse_entry_fields(Tokenizer *tokenizer, Entry *entry) {
+    Entry result = *entry;
     eat_all_whitespace(tokenizer);
 
     char c = peek_next_character(tokenizer);
@@ -846,71 +1542,176 @@ parse_entry(Tokenizer *tokenizer) {
         eat_next_character(tokenizer);
     }
 
-    return result;
+    *entry = result;
 }
 
-internal Entry
-parse_entry_at(Tokenizer *tokenizer, usize offset) {
-    set_tokenizer(tokenizer, offset);
-    Entry result = parse_entry(tokenizer);
-    return result;
-}
+//
+// Tail reader
+// NOTE(dgl): reads the file backwards in blocks and keeps everything from the first block
+// read up to the end of the file in one contiguous buffer. Blank lines and comments at the end
+// of the file are skipped, even if they span multiple blocks.
+//
 
-// TODO(dgl): make this possible with parse_entry_at. We need to set the tokenizer to a buffer
-// offset. But this offset can be before or after the current position. Maybe the best thing would
-// be storing the buffer address somewhere and do the offset setting based on this address.
-// This is a little tricky because new entries do not have meta data.
-internal Entry
-parse_entry_from_meta(Tokenizer *tokenizer, EntryMeta *meta) {
-    tokenizer->input.data = cast(void *, meta->buffer_pos);
-    tokenizer->input.length = meta->length;
-    tokenizer->line = meta->line;
+typedef struct {
+    int     fd;
+    usize   filesize;
+    usize   file_offset; // NOTE(dgl): file offset of the first byte in the buffer
+    Buffer  buffer;
+} Tail_Reader;
+
+typedef struct {
+    Entry   entry;
+    usize   offset; // NOTE(dgl): file offset of the line of the entry
+    usize   length; // NOTE(dgl): line length without the newline
+    usize   end_offset; // NOTE(dgl): file offset of the end time placeholder (0 if there is none)
+    usize   filesize;
+    bool32  found;
+    bool32  ends_with_newline;
+} Tail_Entry;
+
+// NOTE(dgl): prepends the previous block (or more if the buffer is already larger, to keep
+// the copies linear) to the buffer. Returns the number of prepended bytes.
+internal usize
+tail_reader_read_previous(Mem_Arena *arena, Tail_Reader *reader) {
+    usize result = 0;
+    if (reader->file_offset > 0) {
+        usize read_size = min(reader->file_offset, max(cast(usize, TAIL_BLOCK_SIZE), reader->buffer.data_count));
+        usize new_cap = read_size + reader->buffer.data_count;
+
+        // NOTE(dgl): one additional byte to keep the buffer zero terminated.
+        uint8 *data = mem_arena_push_array(arena, uint8, new_cap + 1);
+        usize file_offset = reader->file_offset - read_size;
+        ssize_t res = pread(reader->fd, data, read_size, cast(off_t, file_offset));
+        if (res == cast(ssize_t, read_size)) {
+            if (reader->buffer.data_count > 0) {
+                memcpy(data + read_size, reader->buffer.data, reader->buffer.data_count);
+            }
+            reader->buffer.data = data;
+            reader->buffer.data_count = new_cap;
+            reader->buffer.cap = new_cap;
+            reader->file_offset = file_offset;
+            result = read_size;
+        } else {
+            LOG("Failed to read %lu bytes at offset %lu with error: %d", read_size, file_offset, errno);
+        }
+    }
 
-    Entry result = parse_entry(tokenizer);
     return result;
 }
 
-// NOTE(dgl): offset before last line of file (line containing text)
+// NOTE(dgl): returns the offset of the end time placeholder inside the line or 0 if the
+// line has none. The placeholder starts one space after the first divider and is followed
+// by at least one more space before the next divider.
 internal usize
-get_last_line_offset(Tokenizer *tokenizer) {
+find_end_placeholder(char *line, usize length) {
     usize result = 0;
 
-    char *orig_input = tokenizer->input.text;
-    tokenizer->input.text += tokenizer->input.length;
+    usize cursor = 0;
+    while (cursor < length && line[cursor] != '|') {
+        ++cursor;
+    }
 
-    int32 offset = 0;
-    while(result == 0 && abs(offset) < tokenizer->input.length) {
-        char cursor = peek_character(tokenizer, offset);
-        while (cursor != '\n' && abs(offset) < tokenizer->input.length) {
-            cursor = peek_character(tokenizer, --offset);
-        }
+    usize field_begin = cursor + 1;
+    usize spaces = 0;
+    while (field_begin + spaces < length && line[field_begin + spaces] == ' ') {
+        ++spaces;
+    }
 
-        // NOTE(dgl): ignore whitespace at the beginning of the line
-        int32 whitespace_offset = 1;
-        while(is_whitespace(peek_character(tokenizer, offset + whitespace_offset))) {
-            whitespace_offset++;
-        }
+    if (field_begin + spaces < length &&
+        line[field_begin + spaces] == '|' &&
+        spaces >= DATETIME_CANONICAL_LENGTH + 1) {
+        result = field_begin + 1;
+    }
 
-        char offset_cursor = peek_character(tokenizer, offset + whitespace_offset);
-        char next_offset_cursor = peek_character(tokenizer, offset + whitespace_offset + 1);
-        if (offset_cursor == '\n' ||
-            offset_cursor == '\0' || (
-                offset_cursor == '/' &&
-                next_offset_cursor == '/')
-            ) {
-            offset--;
-        } else {
-            // NOTE(dgl): + 1 to be after the newline
-            // TODO(dgl): needs verification
-            int64 last_line_offset = cast(int64, tokenizer->input.length) + offset + 1;
-            assert(last_line_offset >= 0, "Invalid last line offset");
-            result = cast(usize, last_line_offset);
-        }
+    return result;
+}
+
+internal bool32
+line_is_blank_or_comment(char *line, usize length) {
+    bool32 result = true;
+
+    usize cursor = 0;
+    while (cursor < length && is_whitespace(line[cursor])) {
+        ++cursor;
+    }
+
+    if (cursor < length) {
+        result = (cursor + 1 < length && line[cursor] == '/' && line[cursor + 1] == '/');
     }
 
-    assert(result < tokenizer->input.length, "Invalid offset - got: %lu expected: < %lu", result, tokenizer->input.length);
+    return result;
+}
+
+// NOTE(dgl): parses the last entry of the file without reading the whole file. Only the
+// blocks from the end up to the beginning of the last entry are read.
+internal Tail_Entry
+tail_read_last_entry(Mem_Arena *arena, File_Stats *file, Tokenizer *tokenizer) {
+    Tail_Entry result = {};
+
+    Tail_Reader reader = {};
+    reader.fd = open(file->filename.text, O_RDONLY);
+    if (reader.fd >= 0) {
+        struct stat file_stat = {};
+        fstat(reader.fd, &file_stat);
+        reader.filesize = cast(usize, file_stat.st_size);
+        reader.file_offset = reader.filesize;
+        result.filesize = reader.filesize;
+
+        if (tail_reader_read_previous(arena, &reader) > 0) {
+            char *data = cast(char *, reader.buffer.data);
+            result.ends_with_newline = data[reader.buffer.data_count - 1] == '\n';
+
+            // NOTE(dgl): line_end is the buffer index of the newline (or the end of the buffer)
+            usize line_end = reader.buffer.data_count;
+            for (;;) {
+                usize cursor = line_end;
+                while (cursor > 0 && data[cursor - 1] != '\n') {
+                    --cursor;
+                }
+
+                if (cursor == 0 && reader.file_offset > 0) {
+                    // NOTE(dgl): the line might start in the previous block
+                    usize prepended = tail_reader_read_previous(arena, &reader);
+                    if (prepended == 0) {
+                        break;
+                    }
+                    data = cast(char *, reader.buffer.data);
+                    line_end += prepended;
+                    continue;
+                }
+
+                if (!line_is_blank_or_comment(data + cursor, line_end - cursor)) {
+                    result.found = true;
+                    result.offset = reader.file_offset + cursor;
+                    result.length = line_end - cursor;
+
+                    usize placeholder = find_end_placeholder(data + cursor, result.length);
+                    if (placeholder > 0) {
+                        result.end_offset = result.offset + placeholder;
+                    }
+
+                    Buffer line = {};
+                    line.data = data + cursor;
+                    line.data_count = reader.buffer.data_count - cursor;
+                    line.cap = line.data_count;
+                    fill_tokenizer(tokenizer, &line);
+                    result.entry = parse_entry(tokenizer);
+                    break;
+                }
+
+                if (cursor == 0) {
+                    break;
+                }
+                line_end = cursor - 1;
+            }
+        }
+
+        LOG_DEBUG("Tail reader read %lu bytes of %lu bytes", reader.buffer.data_count, reader.filesize);
+        close(reader.fd);
+    } else {
+        LOG("Could not open file: %s", string_to_c_str(arena, file->filename));
+    }
 
-    tokenizer->input.text = orig_input;
     return result;
 }
 
@@ -937,6 +1738,7 @@ get_timezone_offset() {
     if (string_compare("UTC", tz, 3) != 0) {
         Tokenizer tokenizer = {};
         tokenizer.input = string_from_c_str(tz);
+        tokenizer.base = tokenizer.input.text;
         result = parse_timezone(&tokenizer);
     }
 
@@ -979,32 +1781,103 @@ print_timestamp(Datetime *timestamp) {
                                                               timestamp->offset_second);
 }
 
+// NOTE(dgl): days since 1970-01-01 of the proleptic gregorian calendar. The year starts in
+// march, so the leap day is the last day of the year. Only works for years >= 0 and months 1-12.
+// http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+internal inline int64
+days_from_civil(int32 year, int32 month, int32 day) {
+    int64 y = year - (month <= 2);
+    int64 era = y / 400;
+    int64 year_of_era = y - era * 400;
+    int64 day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    int64 day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    int64 result = era * 146097 + day_of_era - 719468;
+
+    return result;
+}
+
+// NOTE(dgl): the date and time are local to the offset of the datetime, therefore we do not
+// need the timezone of the process (mktime).
 internal inline usize
 datetime_to_epoch(Datetime *datetime) {
     usize result = 0;
-	assert(datetime->year >= 1900, "Year cannot be smaller than 1900");
+    assert(datetime->year >= 1900, "Year cannot be smaller than 1900");
+
+    int64 days = days_from_civil(datetime->year, datetime->month, datetime->day);
+    int64 timestamp = ((days * 24 + datetime->hour) * 60 + datetime->minute) * 60 + datetime->second;
+    int64 timezone_offset = (((datetime->offset_hour * 60) + datetime->offset_minute) * 60) + datetime->offset_second;
+    timestamp += datetime->offset_sign ? timezone_offset : -timezone_offset;
+
+    if (timestamp >= 0) {
+        result = cast(usize, timestamp);
+    }
 
-	struct tm platform_datetime = { .tm_sec  = datetime->second,
-                                    .tm_min  = datetime->minute,
-                                    .tm_hour = datetime->hour,
-                                    .tm_mday = datetime->day,
-                                    .tm_mon  = datetime->month - 1,
-                                    .tm_year = datetime->year - 1900};
+    return result;
+}
 
-	int64 timestamp = mktime(&platform_datetime);
-    if(timestamp >= 0) {
+// NOTE(dgl): converts count datetimes at once. The loop has no branches, therefore the
+// compiler can vectorize it.
+internal void
+datetime_to_epoch_batch(Datetime *datetimes, usize *epochs, usize count) {
+    for (usize index = 0; index < count; ++index) {
+        Datetime *datetime = datetimes + index;
+        int64 days = days_from_civil(datetime->year, datetime->month, datetime->day);
+        int64 timestamp = ((days * 24 + datetime->hour) * 60 + datetime->minute) * 60 + datetime->second;
         int64 timezone_offset = (((datetime->offset_hour * 60) + datetime->offset_minute) * 60) + datetime->offset_second;
+        timestamp += datetime->offset_sign ? timezone_offset : -timezone_offset;
+        epochs[index] = cast(usize, timestamp >= 0 ? timestamp : 0);
+    }
+}
 
-        if(datetime->offset_sign) {
-            assert(timezone_offset < timestamp, "Invalid timezone offset. Offset cannot be larger than the timestamp.");
-            timestamp += timezone_offset;
-        } else {
-            timestamp -= timezone_offset;
-        }
+// NOTE(dgl): offset of the timezone in seconds (negative for -hh:mm:ss)
+internal inline int32
+datetime_offset_seconds(Datetime *datetime) {
+    int32 result = ((datetime->offset_hour * 60) + datetime->offset_minute) * 60 + datetime->offset_second;
+    if (datetime->offset_sign) {
+        result = -result;
+    }
 
-        assert(timestamp >= 0, "Invalid localized timestamp calculation");
-        result = cast(usize, timestamp);
+    return result;
+}
+
+// NOTE(dgl): inverse of days_from_civil
+// http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+internal inline void
+civil_from_days(int64 days, int32 *year, int32 *month, int32 *day) {
+    days += 719468;
+    int64 era = (days >= 0 ? days : days - 146096) / 146097;
+    int64 day_of_era = days - era * 146097;
+    int64 year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    int64 day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    int64 month_index = (5 * day_of_year + 2) / 153;
+
+    *day = cast(int32, day_of_year - (153 * month_index + 2) / 5 + 1);
+    *month = cast(int32, month_index < 10 ? month_index + 3 : month_index - 9);
+    *year = cast(int32, year_of_era + era * 400 + (*month <= 2));
+}
+
+// NOTE(dgl): the datetime of the epoch in the timezone with the offset (in seconds)
+internal Datetime
+epoch_to_datetime(usize epoch, int32 offset_seconds) {
+    Datetime result = {};
+
+    int64 local = cast(int64, epoch) + offset_seconds;
+    int64 days = local / 86400;
+    int64 seconds = local % 86400;
+    if (seconds < 0) {
+        seconds += 86400;
+        days -= 1;
     }
+    civil_from_days(days, &result.year, &result.month, &result.day);
+    result.hour = cast(int32, seconds / 3600);
+    result.minute = cast(int32, (seconds / 60) % 60);
+    result.second = cast(int32, seconds % 60);
+
+    int32 offset = abs(offset_seconds);
+    result.offset_sign = offset_seconds < 0;
+    result.offset_hour = offset / 3600;
+    result.offset_minute = (offset / 60) % 60;
+    result.offset_second = offset % 60;
 
     return result;
 }
@@ -1210,221 +2083,2240 @@ datetime_to_end_of(Report_Type type, Datetime *datetime) {
     return result;
 }
 
+// NOTE(dgl): returns the next tag (@context or +project) of the annotation. Tags end at the
+// next whitespace.
 internal bool32
-report_tag_matches(Commandline *ctx, Entry *entry) {
+annotation_next_tag(Tokenizer *tokenizer, String *tag) {
     bool32 result = false;
 
-    if (ctx->report.filter_count > 0) {
-        Tokenizer tokenizer = {};
-        Buffer buffer = {};
-        buffer.data = entry->annotation.data;
-        buffer.data_count = entry->annotation.length;
-        buffer.cap = entry->annotation.cap;
-        fill_tokenizer(&tokenizer, &buffer);
-
-        while(!tokenizer.has_error && tokenizer.input.length > 0) {
-            char next = peek_next_character(&tokenizer);
-
-            if (next == '@' || next == '+') {
-                char *begin = tokenizer.input.text;
-                uint32 length = 0;
-                while (!is_whitespace(next) && tokenizer.input.length > 0) {
-                    eat_next_character(&tokenizer);
-                    next = peek_next_character(&tokenizer);
-                    ++length;
-                }
-
-                for (int index = 0; index < ctx->report.filter_count; ++index) {
-                    String tag = ctx->report.filter[index];
+    while(!result && !tokenizer->has_error && tokenizer->input.length > 0) {
+        char next = peek_next_character(tokenizer);
 
-                    if (tag.length == length && string_compare(string_to_c_str(ctx->arena, tag), begin, length) == 0) {
-                        result = true;
-                        return result;
-                    }
-                }
+        if (next == '@' || next == '+') {
+            tag->text = tokenizer->input.text;
+            tag->length = 0;
+            while (!is_whitespace(next) && tokenizer->input.length > 0) {
+                eat_next_character(tokenizer);
+                next = peek_next_character(tokenizer);
+                ++tag->length;
             }
-            eat_next_character(&tokenizer);
-            eat_all_whitespace(&tokenizer);
+            tag->cap = tag->length;
+            result = true;
         }
-    } else {
-        result = true;
+        eat_next_character(tokenizer);
+        eat_all_whitespace(tokenizer);
     }
 
     return result;
 }
 
 //
-// Commandline
+// Filter
+// NOTE(dgl): a filter is a boolean expression over tags:
+//     filter = term {["or"] term}     adjacent terms are or'ed
+//     term   = factor {"and" factor}
+//     factor = "not" factor | tag | "(" filter ")"
+// Parentheses can be part of the words of the tags: (+a or +b) and @home, a word can also be the
+// whole (quoted) expression. The expression is
+// compiled once into postfix code. With few tags we evaluate the code for every combination of
+// the tags up front, then an entry only costs a table lookup.
 //
 
-internal void
-commandline_parse_start_cmd(Commandline *ctx, char** args, int args_count) {
-    ctx->start.task_id = -1;
-    int32 cursor = 0;
+typedef enum {
+    Filter_Token_Tag,
+    Filter_Token_And,
+    Filter_Token_Or,
+    Filter_Token_Not,
+    Filter_Token_Open,
+    Filter_Token_Close,
+} Filter_Token_Type;
 
-    while(cursor < args_count &&
-          string_compare("-", args[cursor], 1) == 0) {
-        char *arg = args[cursor++];
-        if (string_compare("-t", arg, 2) == 0) {
-            char *number = args[cursor++];
-            ctx->start.task_id = string_to_int32(number, cast(int32, string_length(number)));
-        } else {
-            ++cursor;
-        }
+typedef struct {
+    Filter_Token_Type  type;
+    String             text;
+} Filter_Token;
+
+typedef struct {
+    Filter_Token  *tokens;
+    uint32         token_count;
+    uint32         cursor;
+    Report_Filter *filter;
+    uint32         depth;
+    uint32         max_depth;
+    char          *error;
+} Filter_Parser;
+
+// NOTE(dgl): the word belongs to the filter if it starts with a tag, a parenthesis or an operator
+internal bool32
+filter_is_word(char *arg) {
+    usize length = 0;
+    while (arg[length] && !is_whitespace(arg[length]) && arg[length] != '(' && arg[length] != ')') {
+        ++length;
     }
 
-    // NOTE(dgl): everything after the flags is considered annotation
-    if(cursor < args_count) {
-        usize required_memory = 0;
-        int32 start_count = cursor;
+    bool32 result = *arg == '@' || *arg == '+' || *arg == '(' || *arg == ')' ||
+                    (length == 3 && string_compare("and", arg, 3) == 0) ||
+                    (length == 2 && string_compare("or", arg, 2) == 0) ||
+                    (length == 3 && string_compare("not", arg, 3) == 0);
+    return result;
+}
 
-        while(cursor < args_count) {
-            required_memory += string_length(args[cursor++]);
-            required_memory += 1; // space or nullbyte
+// NOTE(dgl): returns the slot of the tag or -1 if the filter does not use it
+internal inline uint32
+filter_tag_slot(Report_Filter *filter, String tag) {
+    uint32 result = cast(uint32, -1);
+    for (uint32 slot = 0; slot < filter->tag_count; ++slot) {
+        if (filter->tags[slot].length == tag.length && string_compare(filter->tags[slot].text, tag.text, tag.length) == 0) {
+            result = slot;
+            break;
         }
-        ctx->start.annotation.cap = required_memory;
-        ctx->start.annotation.length = required_memory - 1;
-        ctx->start.annotation.text = mem_arena_push_array(ctx->arena, char, required_memory);
+    }
 
-        char *dest = ctx->start.annotation.text;
-        cursor = start_count;
-        // NOTE(dgl): each annotation is a separate arg therefore we concat them and add a space between
-        while(cursor < args_count) {
-            char *annotation = args[cursor++];
-            usize length = string_length(annotation);
-            string_copy(annotation, length, dest, length);
-            dest += length;
-            *dest++ = ' ';
-        }
+    return result;
+}
 
-        ctx->start.annotation.text[required_memory] = 0;
-    } else {
-        ctx->start.annotation = string_from_c_str("");
+internal void
+filter_emit(Filter_Parser *parser, Filter_Op op, uint32 slot) {
+    Report_Filter *filter = parser->filter;
+    Filter_Code *code = filter->code + filter->code_count++;
+    code->op = op;
+    code->slot = slot;
+
+    if (op == Filter_Op_Tag) {
+        parser->max_depth = max(parser->max_depth, ++parser->depth);
+    } else if (op != Filter_Op_Not) {
+        --parser->depth;
     }
 }
 
-#if DEBUG
-internal void
-commandline_parse_test_cmd(Commandline *ctx, char** args, int args_count) {
-    int32 cursor = 0;
+internal inline bool32
+filter_next_is(Filter_Parser *parser, Filter_Token_Type type) {
+    bool32 result = !parser->error && parser->cursor < parser->token_count && parser->tokens[parser->cursor].type == type;
+    return result;
+}
 
-    ctx->report.type = Report_Type_Today;
-    while(cursor < args_count) {
-        char *arg = args[cursor++];
-        if ((*arg == '@') || (*arg == '+')) {
-            if (ctx->report.filter_count < MAX_TAGS) {
-                String *filter = ctx->report.filter + ctx->report.filter_count;
-                usize length = string_length(arg);
-                filter->length = length;
-                filter->cap = length;
-                filter->text = arg;
-                ctx->report.filter_count++;
-            } else {
-                LOG("Max number of filter exceeded. Filter %s will be ignored", arg);
-            }
+internal void filter_parse_or(Filter_Parser *parser);
+
+internal void
+filter_parse_factor(Filter_Parser *parser) {
+    if (filter_next_is(parser, Filter_Token_Not)) {
+        ++parser->cursor;
+        filter_parse_factor(parser);
+        filter_emit(parser, Filter_Op_Not, 0);
+    } else if (filter_next_is(parser, Filter_Token_Tag)) {
+        Report_Filter *filter = parser->filter;
+        String tag = parser->tokens[parser->cursor++].text;
+        uint32 slot = filter_tag_slot(filter, tag);
+        if (slot == cast(uint32, -1)) {
+            slot = filter->tag_count++;
+            filter->tags[slot] = tag;
         }
+        filter_emit(parser, Filter_Op_Tag, slot);
+    } else if (filter_next_is(parser, Filter_Token_Open)) {
+        ++parser->cursor;
+        filter_parse_or(parser);
+        if (filter_next_is(parser, Filter_Token_Close)) {
+            ++parser->cursor;
+        } else if (!parser->error) {
+            parser->error = "missing )";
+        }
+    } else if (!parser->error) {
+        parser->error = "expected a tag, not or (";
     }
 }
-#endif
 
 internal void
-commandline_parse_report_cmd(Commandline *ctx, char** args, int args_count) {
-    int32 cursor = 0;
+filter_parse_and(Filter_Parser *parser) {
+    filter_parse_factor(parser);
+    while (filter_next_is(parser, Filter_Token_And)) {
+        ++parser->cursor;
+        filter_parse_factor(parser);
+        filter_emit(parser, Filter_Op_And, 0);
+    }
+}
 
-    ctx->report.type = Report_Type_Today;
-    while(cursor < args_count) {
-        char *arg = args[cursor++];
-        if ((string_compare("yes", arg, 3) == 0)) {
-            ctx->report.type = Report_Type_Yesterday;
-        } else if ((string_compare("m", arg, 1) == 0)) {
-            ctx->report.type = Report_Type_Month;
-        } else if ((string_compare("lastm", arg, 5) == 0)) {
-            ctx->report.type = Report_Type_Last_Month;
-        } else if ((string_compare("w", arg, 1) == 0)) {
-            ctx->report.type = Report_Type_Week;
-        } else if ((string_compare("lastw", arg, 5) == 0)) {
-            ctx->report.type = Report_Type_Last_Week;
-        } else if ((string_compare("yea", arg, 3) == 0)) {
-            ctx->report.type = Report_Type_Year;
-        } else if ((string_compare("lasty", arg, 5) == 0)) {
-            ctx->report.type = Report_Type_Last_Year;
-        } else if ((*arg == '@') || (*arg == '+')) {
-            if (ctx->report.filter_count < MAX_TAGS) {
-                String *filter = ctx->report.filter + ctx->report.filter_count;
-                usize length = string_length(arg);
-                filter->length = length;
-                filter->cap = length;
-                filter->text = arg;
-                ctx->report.filter_count++;
-            } else {
-                LOG("Max number of filter exceeded. Filter %s will be ignored", arg);
-            }
+internal void
+filter_parse_or(Filter_Parser *parser) {
+    filter_parse_and(parser);
+    while (!parser->error) {
+        if (filter_next_is(parser, Filter_Token_Or)) {
+            ++parser->cursor;
+        } else if (!filter_next_is(parser, Filter_Token_Tag) &&
+                   !filter_next_is(parser, Filter_Token_Not) &&
+                   !filter_next_is(parser, Filter_Token_Open)) {
+            break;
         }
+        filter_parse_and(parser);
+        filter_emit(parser, Filter_Op_Or, 0);
     }
+}
 
-    Datetime now = get_timestamp();
-    if (ctx->report.type == Report_Type_Custom) {
-        // NOTE(dgl): currently not supported
-    } else {
-        ctx->report.from = datetime_to_beginning_of(ctx->report.type, &now);
-        ctx->report.to = now;
-        if (ctx->report.type > Report_Type_Set_End_Date) {
-            ctx->report.to = datetime_to_end_of(ctx->report.type, &now);
+// NOTE(dgl): runs the code on slot_bits
+internal bool32
+filter_run(Report_Filter *filter) {
+    uint8 *stack = filter->stack;
+    uint32 depth = 0;
+    for (uint32 index = 0; index < filter->code_count; ++index) {
+        Filter_Code *code = filter->code + index;
+        switch (code->op) {
+            case Filter_Op_Tag: {
+                stack[depth++] = (filter->slot_bits[code->slot / 64] >> (code->slot % 64)) & 1;
+            } break;
+            case Filter_Op_Not: {
+                stack[depth - 1] = !stack[depth - 1];
+            } break;
+            case Filter_Op_And: {
+                --depth;
+                stack[depth - 1] &= stack[depth];
+            } break;
+            case Filter_Op_Or: {
+                --depth;
+                stack[depth - 1] |= stack[depth];
+            } break;
         }
     }
 
-    LOG_DEBUG("Report type: %d", ctx->report.type);
-    LOG_DEBUG("Report from: ");
-    print_timestamp(&ctx->report.from);
-    LOG_DEBUG("Report to: ");
-    print_timestamp(&ctx->report.to);
+    bool32 result = stack[0];
+    return result;
 }
 
-internal void
-commandline_parse_csv_cmd(Commandline *ctx, char** args, int args_count) {
+internal inline void
+filter_clear(Report_Filter *filter) {
+    for (uint32 word = 0; word < filter->slot_word_count; ++word) {
+        filter->slot_bits[word] = 0;
+    }
+}
 
+internal inline void
+filter_set(Report_Filter *filter, uint32 slot) {
+    filter->slot_bits[slot / 64] |= cast(uint64, 1) << (slot % 64);
 }
 
-internal void
-commandline_parse(Mem_Arena *arena, Commandline *ctx, char** args, int args_count) {
-    ctx->arena = arena;
-    ctx->is_valid = true;
+// NOTE(dgl): evaluates the filter for the tags in slot_bits
+internal inline bool32
+filter_eval(Report_Filter *filter) {
+    bool32 result = true;
+    if (filter->code_count > 0) {
+        result = filter->truth ? filter->truth[filter->slot_bits[0]] : filter_run(filter);
+    }
 
-    File_Stats home = get_file_stats(arena, string_from_c_str("~/time.txt"));
-    File_Stats local = get_file_stats(arena, string_from_c_str("./time.txt"));
-    ctx->file = local;
-    if (!ctx->file.exists) {
-        ctx->file = home;
+    return result;
+}
+
+// NOTE(dgl): compiles the words of the commandline into the filter
+internal bool32
+filter_compile(Mem_Arena *arena, char **words, int32 word_count, Report_Filter *filter) {
+    *filter = (Report_Filter){};
+
+    uint32 token_cap = 0;
+    for (int32 index = 0; index < word_count; ++index) {
+        token_cap += cast(uint32, string_length(words[index])) + 1;
     }
 
-    struct winsize w;
-    ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+    Filter_Parser parser = {};
+    parser.filter = filter;
+    parser.tokens = mem_arena_push_array(arena, Filter_Token, token_cap);
+    // NOTE(dgl): a quoted word can contain the whole expression
+    for (int32 index = 0; index < word_count; ++index) {
+        char *cursor = words[index];
+        while (*cursor) {
+            if (is_whitespace(*cursor)) {
+                ++cursor;
+            } else if (*cursor == '(' || *cursor == ')') {
+                parser.tokens[parser.token_count++].type = *cursor == '(' ? Filter_Token_Open : Filter_Token_Close;
+                ++cursor;
+            } else {
+                char *word = cursor;
+                while (*cursor && !is_whitespace(*cursor) && *cursor != '(' && *cursor != ')') {
+                    ++cursor;
+                }
 
-    ctx->window_rows = w.ws_row;
-    ctx->window_columns = w.ws_col;
+                Filter_Token *token = parser.tokens + parser.token_count++;
+                token->text.text = word;
+                token->text.length = cast(usize, cursor - word);
+                token->text.cap = token->text.length;
+                if (token->text.length == 3 && string_compare("and", word, 3) == 0) {
+                    token->type = Filter_Token_And;
+                } else if (token->text.length == 2 && string_compare("or", word, 2) == 0) {
+                    token->type = Filter_Token_Or;
+                } else if (token->text.length == 3 && string_compare("not", word, 3) == 0) {
+                    token->type = Filter_Token_Not;
+                } else if (*word == '@' || *word == '+') {
+                    token->type = Filter_Token_Tag;
+                } else if (!parser.error) {
+                    parser.error = "unknown word";
+                }
+            }
+        }
+    }
 
-    // NOTE(dgl): default command type (if nothing else found)
-    ctx->command_type = Command_Type_Report;
+    // NOTE(dgl): every token emits at most one code, implicit ors at most one more
+    filter->code = mem_arena_push_array(arena, Filter_Code, parser.token_count * 2 + 1);
+    filter->tags = mem_arena_push_array(arena, String, parser.token_count + 1);
+    if (!parser.error) {
+        filter_parse_or(&parser);
+    }
+    if (!parser.error && parser.cursor < parser.token_count) {
+        parser.error = "unexpected )";
+    }
 
-    int cursor = 1;
-    // NOTE(dgl): without args
-    if (args_count == 1) {
-        // TODO(dgl): tbd
+    bool32 result = parser.error == 0;
+    if (result) {
+        filter->slot_word_count = max((filter->tag_count + 63) / 64, 1);
+        filter->slot_bits = mem_arena_push_array(arena, uint64, filter->slot_word_count);
+        filter->stack = mem_arena_push_array(arena, uint8, max(parser.max_depth, 1));
+
+        if (filter->tag_count <= FILTER_TRUTH_TABLE_MAX_TAGS) {
+            uint32 combination_count = 0x1 << filter->tag_count;
+            uint8 *truth = mem_arena_push_array(arena, uint8, combination_count);
+            for (uint32 combination = 0; combination < combination_count; ++combination) {
+                filter->slot_bits[0] = combination;
+                truth[combination] = cast(uint8, filter_run(filter));
+            }
+            filter->truth = truth;
+        }
     } else {
-        while (cursor < args_count) {
-            char *arg = args[cursor++];
+        LOG("Invalid filter: %s", parser.error);
+        *filter = (Report_Filter){};
+    }
 
-            if (string_compare("-f", arg, 2) == 0) {
-                if (cursor < args_count) {
-                    char *filename = args[cursor++];
-                    ctx->file = get_file_stats(arena, string_from_c_str(filename));
-                    // TODO(dgl): if a file flag was provided and the file
-                    // does not exist, we should create it.
-                } else {
-                    ctx->is_valid = false;
-                }
-            } else if (string_compare("sta", arg, 3) == 0) {
-                ctx->command_type = Command_Type_Start;
+    return result;
+}
+
+// NOTE(dgl): tokenizes the tags of the annotation. Only used if we filter the entries before
+// they are in a table, otherwise see entry_table_tags_match.
+internal bool32
+report_tag_matches(Commandline *ctx, String annotation) {
+    Report_Filter *filter = &ctx->report.filter;
+    bool32 result = true;
+
+    if (filter->code_count > 0) {
+        Tokenizer tokenizer = {};
+        Buffer buffer = {};
+        buffer.data = annotation.data;
+        buffer.data_count = annotation.length;
+        buffer.cap = annotation.cap;
+        fill_tokenizer(&tokenizer, &buffer);
+
+        filter_clear(filter);
+        String tag = {};
+        while(annotation_next_tag(&tokenizer, &tag)) {
+            uint32 slot = filter_tag_slot(filter, tag);
+            if (slot != cast(uint32, -1)) {
+                filter_set(filter, slot);
+            }
+        }
+        result = filter_eval(filter);
+    }
+
+    return result;
+}
+
+//
+// Report
+//
+
+//
+// Tag dictionary
+// NOTE(dgl): interns the tags of the entries of a table. Every distinct tag gets a dense id in
+// the order it was seen. The ids are stored in an open addressing hash table (linear probing,
+// at most half full). The dictionary keeps its own copy of the tag text, the ids stay valid if
+// the text of the table moves.
+//
+
+typedef struct {
+    uint32   count;
+    uint32   cap;
+    String  *tags; // NOTE(dgl): by id
+    uint64  *hashes; // NOTE(dgl): by id
+    uint32   slot_count; // NOTE(dgl): power of two
+    uint32  *slots; // NOTE(dgl): id + 1, 0 is empty
+} Tag_Dictionary;
+
+internal inline uint64
+tag_hash(String tag) {
+    // NOTE(dgl): FNV-1a, tags are short
+    uint64 result = 0xCBF29CE484222325ULL;
+    for (usize index = 0; index < tag.length; ++index) {
+        result ^= cast(uint8, tag.text[index]);
+        result *= 0x100000001B3ULL;
+    }
+
+    return result;
+}
+
+internal inline uint32
+tag_dictionary_slot(Tag_Dictionary *dictionary, String tag, uint64 hash) {
+    uint32 mask = dictionary->slot_count - 1;
+    uint32 result = cast(uint32, hash) & mask;
+    while (dictionary->slots[result] != 0) {
+        uint32 id = dictionary->slots[result] - 1;
+        String other = dictionary->tags[id];
+        if (dictionary->hashes[id] == hash && other.length == tag.length && memcmp(other.text, tag.text, tag.length) == 0) {
+            break;
+        }
+        result = (result + 1) & mask;
+    }
+
+    return result;
+}
+
+// NOTE(dgl): returns the id of the tag or -1 if it is not in the dictionary
+internal uint32
+tag_dictionary_find(Tag_Dictionary *dictionary, String tag) {
+    uint32 result = cast(uint32, -1);
+    if (dictionary->count > 0) {
+        uint32 slot = tag_dictionary_slot(dictionary, tag, tag_hash(tag));
+        if (dictionary->slots[slot] != 0) {
+            result = dictionary->slots[slot] - 1;
+        }
+    }
+
+    return result;
+}
+
+internal uint32
+tag_dictionary_intern(Mem_Arena *arena, Tag_Dictionary *dictionary, String tag) {
+    if (dictionary->count * 2 >= dictionary->slot_count) {
+        // NOTE(dgl): the old slots stay in the arena, the dictionary only grows a few times
+        uint32 slot_count = max(dictionary->slot_count * 2, TAG_DICTIONARY_MIN_SLOTS);
+        dictionary->slots = mem_arena_push_array(arena, uint32, slot_count);
+        memset(dictionary->slots, 0, slot_count * sizeof(uint32));
+        dictionary->slot_count = slot_count;
+        for (uint32 id = 0; id < dictionary->count; ++id) {
+            uint32 slot = tag_dictionary_slot(dictionary, dictionary->tags[id], dictionary->hashes[id]);
+            dictionary->slots[slot] = id + 1;
+        }
+    }
+
+    uint64 hash = tag_hash(tag);
+    uint32 slot = tag_dictionary_slot(dictionary, tag, hash);
+    if (dictionary->slots[slot] == 0) {
+        if (dictionary->count == dictionary->cap) {
+            uint32 cap = max(dictionary->cap * 2, TAG_DICTIONARY_MIN_SLOTS / 2);
+            if (dictionary->cap == 0) {
+                dictionary->tags = mem_arena_push_array(arena, String, cap);
+                dictionary->hashes = mem_arena_push_array(arena, uint64, cap);
+            } else {
+                dictionary->tags = mem_arena_resize_array(arena, String, dictionary->tags, dictionary->cap, cap);
+                dictionary->hashes = mem_arena_resize_array(arena, uint64, dictionary->hashes, dictionary->cap, cap);
+            }
+            dictionary->cap = cap;
+        }
+
+        String copy = {};
+        copy.text = mem_arena_push_array(arena, char, max(tag.length, 1));
+        copy.length = tag.length;
+        copy.cap = tag.length;
+        memcpy(copy.text, tag.text, tag.length);
+
+        uint32 id = dictionary->count++;
+        dictionary->tags[id] = copy;
+        dictionary->hashes[id] = hash;
+        dictionary->slots[slot] = id + 1;
+    }
+
+    uint32 result = dictionary->slots[slot] - 1;
+    return result;
+}
+
+internal inline int32
+tag_compare(String a, String b) {
+    int32 result = memcmp(a.text, b.text, min(a.length, b.length));
+    if (result == 0) {
+        result = (a.length > b.length) - (a.length < b.length);
+    }
+
+    return result;
+}
+
+// NOTE(dgl): the rank of every id if the tags are ordered by their text. The ids are sorted
+// with an insertion sort, there are only a few distinct tags.
+internal uint32 *
+tag_dictionary_ranks(Mem_Arena *arena, Tag_Dictionary *dictionary) {
+    uint32 *ids = mem_arena_push_array(arena, uint32, max(dictionary->count, 1));
+    for (uint32 index = 0; index < dictionary->count; ++index) {
+        uint32 id = index;
+        uint32 cursor = index;
+        while (cursor > 0 && tag_compare(dictionary->tags[ids[cursor - 1]], dictionary->tags[id]) > 0) {
+            ids[cursor] = ids[cursor - 1];
+            --cursor;
+        }
+        ids[cursor] = id;
+    }
+
+    uint32 *result = mem_arena_push_array(arena, uint32, max(dictionary->count, 1));
+    for (uint32 rank = 0; rank < dictionary->count; ++rank) {
+        result[ids[rank]] = rank;
+    }
+
+    return result;
+}
+
+// NOTE(dgl): the fields of the entries a report needs as struct of arrays. It is filled in one
+// parse, sorting, filtering and printing only read the arrays. The annotations are offsets into
+// text (the file buffer, or a copy of the annotations if we stream the file).
+// If has_tags is set, the tags of the annotations are interned while the entries are pushed.
+// The ids of the tags of an entry are tag_counts[entry] ids at tag_offsets[entry] in tag_ids.
+typedef struct {
+    usize    count;
+    usize    cap;
+    char    *text;
+    usize    text_count; // NOTE(dgl): only used if the table owns the text
+    usize    text_cap;
+
+    bool32          has_tags;
+    Tag_Dictionary  tags;
+    uint32         *tag_offsets;
+    uint32         *tag_counts;
+    uint32         *tag_ids;
+    usize           tag_id_count;
+    usize           tag_id_cap;
+
+    usize   *begins; // NOTE(dgl): epoch
+    usize   *ends; // NOTE(dgl): epoch, 0 if the entry is open
+    int32   *begin_offsets; // NOTE(dgl): timezone offset in seconds
+    int32   *end_offsets;
+    int32   *task_ids;
+    usize   *annotation_offsets;
+    uint32  *annotation_lengths;
+    uint8   *is_open;
+} Entry_Table;
+
+internal void
+entry_table_grow(Mem_Arena *arena, Entry_Table *table, usize cap) {
+    if (table->cap == 0) {
+        table->begins = mem_arena_push_array(arena, usize, cap);
+        table->ends = mem_arena_push_array(arena, usize, cap);
+        table->begin_offsets = mem_arena_push_array(arena, int32, cap);
+        table->end_offsets = mem_arena_push_array(arena, int32, cap);
+        table->task_ids = mem_arena_push_array(arena, int32, cap);
+        table->annotation_offsets = mem_arena_push_array(arena, usize, cap);
+        table->annotation_lengths = mem_arena_push_array(arena, uint32, cap);
+        table->is_open = mem_arena_push_array(arena, uint8, cap);
+        if (table->has_tags) {
+            table->tag_offsets = mem_arena_push_array(arena, uint32, cap);
+            table->tag_counts = mem_arena_push_array(arena, uint32, cap);
+        }
+    } else {
+        table->begins = mem_arena_resize_array(arena, usize, table->begins, table->cap, cap);
+        table->ends = mem_arena_resize_array(arena, usize, table->ends, table->cap, cap);
+        table->begin_offsets = mem_arena_resize_array(arena, int32, table->begin_offsets, table->cap, cap);
+        table->end_offsets = mem_arena_resize_array(arena, int32, table->end_offsets, table->cap, cap);
+        table->task_ids = mem_arena_resize_array(arena, int32, table->task_ids, table->cap, cap);
+        table->annotation_offsets = mem_arena_resize_array(arena, usize, table->annotation_offsets, table->cap, cap);
+        table->annotation_lengths = mem_arena_resize_array(arena, uint32, table->annotation_lengths, table->cap, cap);
+        table->is_open = mem_arena_resize_array(arena, uint8, table->is_open, table->cap, cap);
+        if (table->has_tags) {
+            table->tag_offsets = mem_arena_resize_array(arena, uint32, table->tag_offsets, table->cap, cap);
+            table->tag_counts = mem_arena_resize_array(arena, uint32, table->tag_counts, table->cap, cap);
+        }
+    }
+    table->cap = cap;
+}
+
+// NOTE(dgl): adds the tag to the last entry of the table, every tag is only added once
+internal void
+entry_table_push_tag(Mem_Arena *arena, Entry_Table *table, uint32 id) {
+    usize entry = table->count - 1;
+    uint32 *ids = table->tag_ids + table->tag_offsets[entry];
+    bool32 is_new = true;
+    for (uint32 index = 0; index < table->tag_counts[entry] && is_new; ++index) {
+        is_new = ids[index] != id;
+    }
+
+    if (is_new) {
+        if (table->tag_id_count == table->tag_id_cap) {
+            usize cap = max(table->tag_id_cap * 2, 1024);
+            if (table->tag_id_cap == 0) {
+                table->tag_ids = mem_arena_push_array(arena, uint32, cap);
+            } else {
+                table->tag_ids = mem_arena_resize_array(arena, uint32, table->tag_ids, table->tag_id_cap, cap);
+            }
+            table->tag_id_cap = cap;
+        }
+        table->tag_ids[table->tag_id_count++] = id;
+        ++table->tag_counts[entry];
+    }
+}
+
+// NOTE(dgl): interns the tags of the annotation of the last entry
+internal void
+entry_table_push_tags(Mem_Arena *arena, Entry_Table *table, String annotation) {
+    usize entry = table->count - 1;
+    table->tag_offsets[entry] = cast(uint32, table->tag_id_count);
+    table->tag_counts[entry] = 0;
+
+    Tokenizer tokenizer = {};
+    Buffer buffer = {};
+    buffer.data = annotation.data;
+    buffer.data_count = annotation.length;
+    buffer.cap = annotation.cap;
+    fill_tokenizer(&tokenizer, &buffer);
+
+    String tag = {};
+    while(annotation_next_tag(&tokenizer, &tag)) {
+        entry_table_push_tag(arena, table, tag_dictionary_intern(arena, &table->tags, tag));
+    }
+}
+
+// NOTE(dgl): the annotation of the entry must point into the text of the table
+internal void
+entry_table_push(Mem_Arena *arena, Entry_Table *table, Entry *entry, usize begin, usize end) {
+    if (table->count == table->cap) {
+        entry_table_grow(arena, table, max(table->cap * 2, 1024));
+    }
+
+    usize index = table->count++;
+    table->is_open[index] = entry->end.year == 0;
+    table->begins[index] = begin;
+    table->ends[index] = table->is_open[index] ? 0 : end;
+    table->begin_offsets[index] = datetime_offset_seconds(&entry->begin);
+    table->end_offsets[index] = datetime_offset_seconds(&entry->end);
+    table->task_ids[index] = entry->task_id;
+    table->annotation_offsets[index] = cast(usize, entry->annotation.text - table->text);
+    table->annotation_lengths[index] = cast(uint32, entry->annotation.length);
+    if (table->has_tags) {
+        entry_table_push_tags(arena, table, entry->annotation);
+    }
+}
+
+// NOTE(dgl): copies the annotation of the entry into the text of the table
+internal void
+entry_table_push_copy(Mem_Arena *arena, Entry_Table *table, Entry *entry, usize begin, usize end) {
+    usize length = entry->annotation.length;
+    if (table->text_count + length > table->text_cap) {
+        usize new_cap = max(table->text_cap * 2, table->text_count + length + kilobytes(4));
+        if (table->text) {
+            table->text = mem_arena_resize_array(arena, char, table->text, table->text_cap, new_cap);
+        } else {
+            table->text = mem_arena_push_array(arena, char, new_cap);
+        }
+        table->text_cap = new_cap;
+    }
+
+    Entry copy = *entry;
+    copy.annotation.text = table->text + table->text_count;
+    if (length > 0) {
+        memcpy(copy.annotation.text, entry->annotation.text, length);
+    }
+    table->text_count += length;
+
+    entry_table_push(arena, table, &copy, begin, end);
+}
+
+// NOTE(dgl): appends the entries of src. Both tables must use the same text.
+internal void
+entry_table_append(Mem_Arena *arena, Entry_Table *dest, Entry_Table *src) {
+    assert(dest->text == src->text, "Tables must share the text");
+    if (src->count > 0) {
+        if (dest->count + src->count > dest->cap) {
+            entry_table_grow(arena, dest, dest->count + src->count);
+        }
+
+        usize count = dest->count;
+        memcpy(dest->begins + count, src->begins, src->count * sizeof(usize));
+        memcpy(dest->ends + count, src->ends, src->count * sizeof(usize));
+        memcpy(dest->begin_offsets + count, src->begin_offsets, src->count * sizeof(int32));
+        memcpy(dest->end_offsets + count, src->end_offsets, src->count * sizeof(int32));
+        memcpy(dest->task_ids + count, src->task_ids, src->count * sizeof(int32));
+        memcpy(dest->annotation_offsets + count, src->annotation_offsets, src->count * sizeof(usize));
+        memcpy(dest->annotation_lengths + count, src->annotation_lengths, src->count * sizeof(uint32));
+        memcpy(dest->is_open + count, src->is_open, src->count * sizeof(uint8));
+
+        if (dest->has_tags && src->has_tags) {
+            // NOTE(dgl): the ids of src are mapped to the ids of dest
+            uint32 *ids = mem_arena_push_array(arena, uint32, max(src->tags.count, 1));
+            for (uint32 id = 0; id < src->tags.count; ++id) {
+                ids[id] = tag_dictionary_intern(arena, &dest->tags, src->tags.tags[id]);
+            }
+
+            if (dest->tag_id_count + src->tag_id_count > dest->tag_id_cap) {
+                usize cap = dest->tag_id_count + src->tag_id_count;
+                if (dest->tag_id_cap == 0) {
+                    dest->tag_ids = mem_arena_push_array(arena, uint32, max(cap, 1));
+                } else {
+                    dest->tag_ids = mem_arena_resize_array(arena, uint32, dest->tag_ids, dest->tag_id_cap, cap);
+                }
+                dest->tag_id_cap = max(cap, 1);
+            }
+            for (usize index = 0; index < src->tag_id_count; ++index) {
+                dest->tag_ids[dest->tag_id_count + index] = ids[src->tag_ids[index]];
+            }
+            for (usize index = 0; index < src->count; ++index) {
+                dest->tag_offsets[count + index] = src->tag_offsets[index] + cast(uint32, dest->tag_id_count);
+                dest->tag_counts[count + index] = src->tag_counts[index];
+            }
+            dest->tag_id_count += src->tag_id_count;
+        }
+
+        dest->count += src->count;
+    }
+}
+
+internal inline String
+entry_table_annotation(Entry_Table *table, usize index) {
+    String result = {};
+    result.text = table->text + table->annotation_offsets[index];
+    result.length = table->annotation_lengths[index];
+    result.cap = result.length;
+
+    return result;
+}
+
+// NOTE(dgl): maps the tag ids of the table to the slots of the filter (-1 if the filter does
+// not use the tag)
+typedef struct {
+    Report_Filter *filter;
+    uint32        *slots;
+} Tag_Filter;
+
+internal Tag_Filter
+report_tag_filter(Mem_Arena *arena, Commandline *ctx, Entry_Table *table) {
+    Tag_Filter result = {};
+    result.filter = &ctx->report.filter;
+    if (result.filter->code_count > 0) {
+        assert(table->has_tags, "The table has no tags");
+        result.slots = mem_arena_push_array(arena, uint32, max(table->tags.count, 1));
+        memset(result.slots, 0xFF, max(table->tags.count, 1) * sizeof(uint32));
+        for (uint32 slot = 0; slot < result.filter->tag_count; ++slot) {
+            uint32 id = tag_dictionary_find(&table->tags, result.filter->tags[slot]);
+            if (id != cast(uint32, -1)) {
+                result.slots[id] = slot;
+            }
+        }
+    }
+
+    return result;
+}
+
+// NOTE(dgl): tags are only interned if the report filters, sorts or groups by them
+internal inline bool32
+report_needs_tags(Commandline *ctx) {
+    bool32 result = ctx->report.filter.code_count > 0 || ctx->report.sort == Report_Sort_Tag ||
+                    ctx->report.group_by == Report_Group_Context || ctx->report.group_by == Report_Group_Project;
+    return result;
+}
+
+internal inline bool32
+entry_table_tags_match(Entry_Table *table, Tag_Filter *tag_filter, usize entry) {
+    Report_Filter *filter = tag_filter->filter;
+    bool32 result = true;
+    if (filter->code_count > 0) {
+        filter_clear(filter);
+        uint32 *ids = table->tag_ids + table->tag_offsets[entry];
+        for (uint32 index = 0; index < table->tag_counts[entry]; ++index) {
+            uint32 slot = tag_filter->slots[ids[index]];
+            if (slot != cast(uint32, -1)) {
+                filter_set(filter, slot);
+            }
+        }
+        result = filter_eval(filter);
+    }
+
+    return result;
+}
+
+typedef struct {
+    Mem_Arena  *arena;
+    Datetime   now; // NOTE(dgl): end of active entries
+    usize      total_seconds;
+    usize      daily_seconds;
+    int32      last_day;
+    int32      print_flags;
+    bool32     is_flat; // NOTE(dgl): entries are not in chronological order, no daily totals
+} Report_Printer;
+
+internal void
+report_print_entry(Report_Printer *printer, usize begin, Datetime *begin_datetime, Datetime *end_datetime) {
+    Datetime end_datetime_or_now = *end_datetime;
+    if (end_datetime_or_now.year == 0) { end_datetime_or_now = printer->now; }
+    usize end = datetime_to_epoch(&end_datetime_or_now);
+    assert(begin <= end, "End time cannot be larger than begin time");
+    usize difftime = end - begin;
+
+    printer->total_seconds += difftime;
+
+    if (printer->is_flat) {
+        print_datetime(printer->arena, printer->print_flags, "%td\t%tt - %tt => \t %th hs\n", *begin_datetime, *begin_datetime, end_datetime_or_now, difftime);
+    } else {
+        if (begin_datetime->day != printer->last_day && printer->last_day > 0) {
+            print_datetime(printer->arena, printer->print_flags, "\t\t%th hs\n", printer->daily_seconds);
+            printer->daily_seconds = 0;
+        }
+
+        if (printer->daily_seconds == 0) {
+            print_datetime(printer->arena, printer->print_flags, "%td\t", *begin_datetime);
+        }
+
+        printer->daily_seconds += difftime;
+        printer->last_day = begin_datetime->day;
+
+        print_datetime(printer->arena, printer->print_flags, "\n\t%tt - %tt => \t %th hs", *begin_datetime, end_datetime_or_now, difftime);
+    }
+}
+
+internal void
+report_print_total(Report_Printer *printer) {
+    if (printer->is_flat) {
+        print_datetime(printer->arena, printer->print_flags, "\n");
+    } else {
+        print_datetime(printer->arena, printer->print_flags, "\t\t%th hs\n\n", printer->daily_seconds);
+    }
+    print_datetime(printer->arena, printer->print_flags, "Total hours: %th hs\n", printer->total_seconds);
+}
+
+// NOTE(dgl): reads the file in chunks of REPORT_CHUNK_SIZE. A line which does not end in the
+// current chunk is moved to the front of the chunk and completed by the next read. We only keep
+// the fields of the matching entries, therefore the memory depends on the chunk size and the
+// number of matches but not on the file size.
+internal void
+report_stream_entries(Commandline *ctx, Mem_Arena *arena, Mem_Arena *temp_arena, usize from_sentinel, usize to_sentinel, Entry_Table *table, Tokenizer *tokenizer, File_Generation *generation) {
+
+    int fd = open(ctx->file.filename.text, O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        // NOTE(dgl): we only read up to the size the file had when we opened it. Entries which are
+        // appended while reading are not part of this report.
+        struct stat file_stat = {};
+        fstat(fd, &file_stat);
+        *generation = file_generation_from_stat(&file_stat);
+        usize remaining = cast(usize, file_stat.st_size);
+
+        Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+        {
+            usize chunk_cap = REPORT_CHUNK_SIZE;
+            char *chunk = mem_arena_push_array(tmp_arena.arena, char, chunk_cap);
+            usize chunk_count = 0;
+            int32 line = 1;
+            bool32 is_eof = false;
+
+            while (!is_eof && !tokenizer->has_error) {
+                if (chunk_count == chunk_cap) {
+                    // NOTE(dgl): the line is longer than our chunk
+                    chunk = mem_arena_resize_array(tmp_arena.arena, char, chunk, chunk_cap, chunk_cap * 2);
+                    chunk_cap *= 2;
+                }
+
+                ssize_t res = read(fd, chunk + chunk_count, min(chunk_cap - chunk_count, remaining));
+                if (res < 0) {
+                    LOG("Failed to read file %s with error: %d", string_to_c_str(temp_arena, ctx->file.filename), errno);
+                    break;
+                }
+                is_eof = (res == 0);
+                chunk_count += cast(usize, res);
+                remaining -= cast(usize, res);
+
+                usize line_begin = 0;
+                usize cursor = 0;
+                while (cursor < chunk_count && !tokenizer->has_error) {
+                    char *line_end = memchr(chunk + cursor, '\n', chunk_count - cursor);
+                    usize line_length = 0;
+                    if (line_end) {
+                        line_length = cast(usize, line_end - (chunk + line_begin));
+                    } else if (is_eof) {
+                        line_length = chunk_count - line_begin;
+                    } else {
+                        // NOTE(dgl): incomplete line, we need the next chunk
+                        break;
+                    }
+
+                    if (!line_is_blank_or_comment(chunk + line_begin, line_length)) {
+                        Buffer buffer = {};
+                        buffer.data = chunk + line_begin;
+                        buffer.data_count = line_length;
+                        buffer.cap = line_length;
+                        fill_tokenizer(tokenizer, &buffer);
+                        tokenizer->base_line = line;
+
+                        Entry entry = parse_entry(tokenizer);
+                        if (!tokenizer->has_error) {
+                            usize begin = datetime_to_epoch(&entry.begin);
+                            if (begin > from_sentinel && begin < to_sentinel && report_tag_matches(ctx, entry.annotation)) {
+                                usize end = entry.end.year > 0 ? datetime_to_epoch(&entry.end) : 0;
+                                entry_table_push_copy(arena, table, &entry, begin, end);
+                            }
+                        }
+                    }
+
+                    ++line;
+                    line_begin += line_length + 1;
+                    cursor = line_begin;
+                }
+
+                // NOTE(dgl): move the incomplete line to the front
+                if (line_begin < chunk_count) {
+                    usize rest = chunk_count - line_begin;
+                    memmove(chunk, chunk + line_begin, rest);
+                    chunk_count = rest;
+                } else {
+                    chunk_count = 0;
+                }
+            }
+        }
+        mem_arena_end_temp(tmp_arena);
+        close(fd);
+    } else {
+        LOG("Could not open file: %s", string_to_c_str(arena, ctx->file.filename));
+    }
+}
+
+//
+// Range seek
+// NOTE(dgl): start appends the entries, therefore the begins are almost always in chronological
+// order. If we know that the file is ordered we binary search the byte offsets of the first
+// lines with a begin in the report range and only parse this window. Otherwise (or if we cannot
+// parse an entry) we parse the whole file. Samples cannot tell, a single entry out of order
+// between them would be lost. The caller gets the order from the index, see index_is_ordered.
+//
+
+// NOTE(dgl): returns the offset of the first entry at or after offset (the rest of the line offset
+// points into, blank lines and comments are skipped) or the buffer size if there is none.
+internal usize
+range_seek_entry(Buffer *buffer, usize offset, usize *begin, bool32 *is_valid) {
+    char *data = cast(char *, buffer->data);
+    if (offset > 0 && data[offset - 1] != '\n') {
+        char *newline = memchr(data + offset, '\n', buffer->data_count - offset);
+        offset = newline ? cast(usize, newline - data) + 1 : buffer->data_count;
+    }
+
+    Tokenizer tokenizer = {};
+    fill_tokenizer(&tokenizer, buffer);
+    tokenizer.input.text += offset;
+    tokenizer.input.length -= offset;
+
+    // NOTE(dgl): eat_all_whitespace stops after newlines
+    char *previous = 0;
+    while (previous != tokenizer.input.text) {
+        previous = tokenizer.input.text;
+        eat_all_whitespace(&tokenizer);
+    }
+
+    usize result = cast(usize, tokenizer.input.text - data);
+    if (result < buffer->data_count) {
+        Datetime datetime = parse_datetime(&tokenizer);
+        if (tokenizer.has_error) {
+            *is_valid = false;
+        } else {
+            *begin = datetime_to_epoch(&datetime);
+        }
+    }
+
+    return result;
+}
+
+internal usize
+range_seek_after(Buffer *buffer, usize sentinel, bool32 *is_valid) {
+    usize low = 0;
+    usize high = buffer->data_count;
+    while (low < high && *is_valid) {
+        usize middle = low + (high - low) / 2;
+        usize begin = 0;
+        usize entry = range_seek_entry(buffer, middle, &begin, is_valid);
+        if (entry == buffer->data_count || begin > sentinel) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+
+    usize begin = 0;
+    usize result = range_seek_entry(buffer, low, &begin, is_valid);
+    return result;
+}
+
+// NOTE(dgl): returns false if the file must be parsed completely
+internal bool32
+range_seek(Buffer *buffer, bool32 is_ordered, usize from_sentinel, usize to_sentinel, usize *window_begin, usize *window_end) {
+    bool32 result = false;
+    if (buffer->data_count < RANGE_SEEK_MIN_SIZE) {
+        LOG_DEBUG("File is smaller than %lu bytes, parsing the whole file", cast(usize, RANGE_SEEK_MIN_SIZE));
+    } else if (!is_ordered) {
+        LOG_DEBUG("Entries are not known to be ordered, parsing the whole file");
+    } else {
+        result = true;
+        *window_begin = range_seek_after(buffer, from_sentinel, &result);
+        *window_end = range_seek_after(buffer, to_sentinel - 1, &result);
+        result = result && *window_begin <= *window_end;
+        if (!result) {
+            LOG_DEBUG("Could not find the range in the file, parsing the whole file");
+        }
+    }
+
+    if (result) {
+        LOG_DEBUG("Range seek window from %lu to %lu of %lu bytes", *window_begin, *window_end, buffer->data_count);
+    } else {
+        *window_begin = 0;
+        *window_end = buffer->data_count;
+    }
+
+    return result;
+}
+
+//
+// Parallel parsing
+// NOTE(dgl): the buffer is split into shards at newline boundaries. Every shard is parsed on its
+// own thread into its own arena and the entries are concatenated afterwards. The tokenizers of
+// the shards use the beginning of the buffer as base, line numbers of errors are calculated from
+// there and do not depend on the previous shards.
+//
+
+typedef struct {
+    Buffer     *buffer;
+    usize       begin;
+    usize       end;
+    usize       from_sentinel;
+    usize       to_sentinel;
+
+    Mem_Arena   arena;
+    Tokenizer   tokenizer;
+    Entry_Table table;
+} Parse_Shard;
+
+internal void
+parse_shard(Parse_Shard *shard) {
+    Mem_Arena *arena = &shard->arena;
+    Tokenizer *tokenizer = &shard->tokenizer;
+    fill_tokenizer(tokenizer, shard->buffer);
+    tokenizer->input.text += shard->begin;
+    tokenizer->input.length = shard->end - shard->begin;
+
+    Structural_Index structurals = {};
+    structural_index_init(arena, &structurals, shard->buffer->data, shard->begin, shard->end);
+    tokenizer->structurals = &structurals;
+
+    Entry_Table *table = &shard->table;
+    table->text = shard->buffer->data;
+
+    // NOTE(dgl): we parse the begins of a batch of entries, convert them at once and only parse
+    // the other fields of the entries in the range.
+    Datetime batch_begins[EPOCH_BATCH_SIZE];
+    usize batch_epochs[EPOCH_BATCH_SIZE];
+    char *batch_fields[EPOCH_BATCH_SIZE];
+    char *batch_line_ends[EPOCH_BATCH_SIZE];
+    uint32 batch_count = 0;
+    eat_all_whitespace(tokenizer);
+    while(!tokenizer->has_error && tokenizer->input.length > 0) {
+        eat_all_whitespace(tokenizer);
+        batch_begins[batch_count] = parse_datetime(tokenizer);
+
+        char *fields = tokenizer->input.text;
+        if (!tokenizer->has_error) {
+            usize position = structural_next(&structurals, cast(usize, fields - structurals.base));
+            if (position >= structurals.count || structurals.base[position] != '|') {
+                token_error(tokenizer, "Failed to parse entry. Expected a divider (|)");
+            }
+        }
+
+        char *line_end = find_next_newline(tokenizer);
+        eat_characters_until(tokenizer, line_end);
+        if (peek_next_character(tokenizer) == '\n') {
+            eat_next_character(tokenizer);
+        }
+        eat_all_whitespace(tokenizer);
+        if (!tokenizer->has_error) {
+            batch_fields[batch_count] = fields;
+            batch_line_ends[batch_count] = line_end;
+            ++batch_count;
+        }
+
+        if (batch_count == EPOCH_BATCH_SIZE || tokenizer->has_error || tokenizer->input.length == 0) {
+            datetime_to_epoch_batch(batch_begins, batch_epochs, batch_count);
+            for (uint32 index = 0; index < batch_count; ++index) {
+                usize begin = batch_epochs[index];
+                if (begin > shard->from_sentinel && begin < shard->to_sentinel) {
+                    Tokenizer line = {};
+                    line.input.text = batch_fields[index];
+                    line.input.length = cast(usize, batch_line_ends[index] - batch_fields[index]);
+                    line.base = tokenizer->base;
+                    line.base_line = tokenizer->base_line;
+
+                    Entry entry = {};
+                    entry.begin = batch_begins[index];
+                    parse_entry_fields(&line, &entry);
+                    if (line.has_error) {
+                        // NOTE(dgl): this entry is before the position of the tokenizer, its error comes first.
+                        tokenizer->has_error = true;
+                        memcpy(tokenizer->error_msg, line.error_msg, sizeof(tokenizer->error_msg));
+                        break;
+                    }
+
+                    usize end = entry.end.year > 0 ? datetime_to_epoch(&entry.end) : 0;
+                    entry_table_push(arena, table, &entry, begin, end);
+                }
+            }
+            batch_count = 0;
+        }
+    }
+
+    tokenizer->structurals = 0;
+}
+
+internal void *
+parse_shard_thread(void *data) {
+    parse_shard(cast(Parse_Shard *, data));
+    return 0;
+}
+
+// NOTE(dgl): the thread count of the -j flag, 0 uses all cores
+internal uint32
+thread_count_or_cores(uint32 thread_count) {
+    uint32 result = thread_count;
+    if (result == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        result = cores > 0 ? cast(uint32, cores) : 1;
+    }
+
+    return result;
+}
+
+// NOTE(dgl): parses the entries of the buffer into the table with up to thread_count threads
+// (0 uses all cores). Like the sequential parse we keep the entries up to the first error.
+internal void
+parse_entries(Mem_Arena *arena, Buffer *buffer, usize window_begin, usize window_end, usize from_sentinel, usize to_sentinel, uint32 thread_count, Entry_Table *table, Tokenizer *tokenizer) {
+    usize count = 0;
+
+    thread_count = thread_count_or_cores(thread_count);
+    usize window_size = window_end - window_begin;
+    usize max_shard_count = max(window_size / PARSE_SHARD_MIN_SIZE, 1);
+    uint32 shard_count = cast(uint32, min(min(cast(usize, thread_count), max_shard_count), cast(usize, MAX_PARSE_THREADS)));
+    LOG_DEBUG("Parsing %lu bytes with %u threads", window_size, shard_count);
+
+    char *data = cast(char *, buffer->data);
+    Parse_Shard *shards = mem_arena_push_array(arena, Parse_Shard, shard_count);
+    pthread_t threads[MAX_PARSE_THREADS];
+    bool32 is_running[MAX_PARSE_THREADS] = {};
+
+    usize begin = window_begin;
+    for (uint32 index = 0; index < shard_count; ++index) {
+        Parse_Shard *shard = shards + index;
+        *shard = (Parse_Shard){};
+
+        // NOTE(dgl): a shard ends after a newline, entries never span two shards
+        usize end = window_end;
+        if (index + 1 < shard_count) {
+            end = max(begin, window_begin + (window_size / shard_count) * (index + 1));
+            char *newline = memchr(data + end, '\n', window_end - end);
+            end = newline ? cast(usize, newline - data) + 1 : window_end;
+        }
+
+        shard->table.has_tags = table->has_tags;
+        shard->buffer = buffer;
+        shard->begin = begin;
+        shard->end = end;
+        shard->from_sentinel = from_sentinel;
+        shard->to_sentinel = to_sentinel;
+        begin = end;
+
+        if (!mem_arena_reserve(&shard->arena, 0, PARSE_SHARD_RESERVE_SIZE, "shard_arena")) {
+            LOG("Failed to reserve memory for shard %u", index);
+            shard->tokenizer.has_error = true;
+            stbsp_snprintf(shard->tokenizer.error_msg, array_count(shard->tokenizer.error_msg), "Failed to reserve memory");
+            continue;
+        }
+
+        // NOTE(dgl): the first shard is parsed on this thread
+        if (index > 0) {
+            is_running[index] = (pthread_create(threads + index, 0, parse_shard_thread, shard) == 0);
+            if (!is_running[index]) {
+                LOG_DEBUG("Failed to create thread for shard %u, parsing it on the main thread", index);
+            }
+        }
+    }
+
+    for (uint32 index = 0; index < shard_count; ++index) {
+        Parse_Shard *shard = shards + index;
+        if (index == 0 || !is_running[index]) {
+            if (shard->arena.base) {
+                parse_shard(shard);
+            }
+        }
+    }
+
+    uint32 valid_shard_count = shard_count;
+    for (uint32 index = 0; index < shard_count; ++index) {
+        Parse_Shard *shard = shards + index;
+        if (is_running[index]) {
+            pthread_join(threads[index], 0);
+        }
+        if (index < valid_shard_count) {
+            count += shard->table.count;
+            if (shard->tokenizer.has_error) {
+                tokenizer->has_error = true;
+                memcpy(tokenizer->error_msg, shard->tokenizer.error_msg, sizeof(tokenizer->error_msg));
+                valid_shard_count = index + 1;
+            }
+        }
+    }
+
+    table->text = buffer->data;
+    entry_table_grow(arena, table, max(count, 1));
+    for (uint32 index = 0; index < shard_count; ++index) {
+        Parse_Shard *shard = shards + index;
+        if (index < valid_shard_count) {
+            shard->table.text = table->text;
+            entry_table_append(arena, table, &shard->table);
+        }
+        if (shard->arena.base) {
+            mem_arena_release(&shard->arena);
+        }
+    }
+}
+
+//
+// Hash
+// NOTE(dgl): streaming 64 bit hash of the file content. Four lanes consume 8 byte words (xxhash
+// like rounds), the bytes of an incomplete block wait in the state. The state can be stored and
+// continued later, finishing the hash does not change it.
+//
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME_3 0x165667B19E3779F9ULL
+
+typedef struct {
+    uint64  lanes[4];
+    uint64  count;
+    uint8   pending[32]; // NOTE(dgl): the last count % 32 bytes
+} Hash_State;
+
+internal inline uint64
+hash_rotate(uint64 value, int32 bits) {
+    uint64 result = (value << bits) | (value >> (64 - bits));
+    return result;
+}
+
+internal inline uint64
+hash_round(uint64 lane, uint64 word) {
+    lane += word * HASH_PRIME_2;
+    lane = hash_rotate(lane, 31);
+    lane *= HASH_PRIME_1;
+    return lane;
+}
+
+internal inline void
+hash_block(Hash_State *state, uint8 *block) {
+    for (int32 index = 0; index < 4; ++index) {
+        uint64 word = 0;
+        memcpy(&word, block + index * 8, sizeof(word));
+        state->lanes[index] = hash_round(state->lanes[index], word);
+    }
+}
+
+internal Hash_State
+hash_init() {
+    Hash_State result = {};
+    result.lanes[0] = HASH_PRIME_1 + HASH_PRIME_2;
+    result.lanes[1] = HASH_PRIME_2;
+    result.lanes[2] = 0;
+    result.lanes[3] = 0 - HASH_PRIME_1;
+
+    return result;
+}
+
+internal void
+hash_update(Hash_State *state, void *data, usize size) {
+    uint8 *bytes = cast(uint8 *, data);
+    usize pending = state->count % 32;
+    state->count += size;
+
+    if (pending > 0) {
+        usize fill = min(32 - pending, size);
+        memcpy(state->pending + pending, bytes, fill);
+        bytes += fill;
+        size -= fill;
+        if (pending + fill == 32) {
+            hash_block(state, state->pending);
+        }
+    }
+
+    while (size >= 32) {
+        hash_block(state, bytes);
+        bytes += 32;
+        size -= 32;
+    }
+
+    if (size > 0) {
+        memcpy(state->pending, bytes, size);
+    }
+}
+
+internal uint64
+hash_finish(Hash_State *state) {
+    uint64 result = hash_rotate(state->lanes[0], 1) + hash_rotate(state->lanes[1], 7) +
+                    hash_rotate(state->lanes[2], 12) + hash_rotate(state->lanes[3], 18);
+    result = (result ^ state->count) * HASH_PRIME_1;
+
+    usize pending = state->count % 32;
+    for (usize index = 0; index < pending; ++index) {
+        result ^= cast(uint64, state->pending[index]) * HASH_PRIME_3;
+        result = hash_rotate(result, 11) * HASH_PRIME_1;
+    }
+
+    result ^= result >> 33;
+    result *= HASH_PRIME_2;
+    result ^= result >> 29;
+    result *= HASH_PRIME_3;
+    result ^= result >> 32;
+
+    return result;
+}
+
+// NOTE(dgl): hashes size bytes of the file starting at offset
+internal bool32
+hash_update_from_file(Mem_Arena *temp_arena, int fd, usize offset, usize size, Hash_State *state) {
+    bool32 result = true;
+
+    Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+    {
+        uint8 *chunk = mem_arena_push_array(tmp_arena.arena, uint8, COPY_BUFFER_SIZE);
+        while (size > 0 && result) {
+            ssize_t res = pread(fd, chunk, min(size, cast(usize, COPY_BUFFER_SIZE)), cast(off_t, offset));
+            if (res <= 0) {
+                result = false;
+            } else {
+                hash_update(state, chunk, cast(usize, res));
+                offset += cast(usize, res);
+                size -= cast(usize, res);
+            }
+        }
+    }
+    mem_arena_end_temp(tmp_arena);
+
+    return result;
+}
+
+//
+// Index
+// NOTE(dgl): optional sidecar <time file>.idx with one fixed size record per entry. It is only
+// valid for the file with the size, modification time and inode stored in the header. The header
+// also keeps the hash of the file content, but a report only hashes the last line (stop rewrites
+// it in place) if the metadata matches. The prefix up to the last line is only hashed if the
+// metadata changed, to decide if the appended tail can be parsed or the index is rebuilt.
+// start, stop and continue update an existing index, reports answer from it and rebuild it if it
+// is stale. Tags are interned in the header, every record has a bitset of its tags.
+//
+// header | record 0 | record 1 | ...
+//
+
+typedef enum {
+    Index_Tags_Overflow = 0x1 << 0, // NOTE(dgl): not every tag fits into the bitset, tag filters need the text
+    Index_Ordered       = 0x1 << 1, // NOTE(dgl): the records are sorted by begin
+} Index_Flags;
+
+typedef enum {
+    Index_Record_Open = 0x1 << 0,
+} Index_Record_Flags;
+
+typedef struct {
+    uint32      magic;
+    uint32      version;
+    uint64      filesize; // NOTE(dgl): size of the indexed time file
+    int64       mtime_sec;
+    int64       mtime_nsec;
+    uint64      inode;
+    uint64      hash;
+    Hash_State  state; // NOTE(dgl): hash state after filesize bytes
+    uint64      last_offset; // NOTE(dgl): offset of the line of the last record
+    Hash_State  last_state; // NOTE(dgl): hash state at last_offset, stop changes the last line
+    uint64      record_count;
+    uint32      tag_count;
+    uint32      flags;
+    char        tags[INDEX_MAX_TAGS][INDEX_TAG_SIZE];
+} Index_Header;
+
+typedef struct {
+    uint64  offset;
+    uint64  begin; // NOTE(dgl): epoch
+    uint64  end; // NOTE(dgl): epoch, 0 if the entry is open
+    int32   begin_offset; // NOTE(dgl): timezone offset in seconds
+    int32   end_offset;
+    int32   task_id;
+    uint32  flags;
+    uint64  tags;
+} Index_Record;
+
+typedef struct {
+    Index_Header   header;
+    Index_Record  *records; // NOTE(dgl): records[0] is the record with the number record_base
+    usize          record_base;
+    usize          record_cap;
+    Buffer         mapping; // NOTE(dgl): records point into the mapped index file if we read it
+} Time_Index;
+
+internal void
+index_filename(File_Stats *file, char *filename) {
+    assert(file->filename.length + 5 < MAX_FILENAME_SIZE, "Filename too long. Increase MAX_FILENAME_SIZE.");
+    stbsp_snprintf(filename, MAX_FILENAME_SIZE, "%.*s.idx", cast(int32, file->filename.length), file->filename.text);
+}
+
+internal inline bool32
+index_header_matches(Index_Header *header, struct stat *file_stat) {
+    bool32 result = header->filesize == cast(uint64, file_stat->st_size) &&
+                    header->mtime_sec == file_stat->st_mtim.tv_sec &&
+                    header->mtime_nsec == file_stat->st_mtim.tv_nsec &&
+                    header->inode == cast(uint64, file_stat->st_ino);
+    return result;
+}
+
+internal inline void
+index_header_set_file(Index_Header *header, struct stat *file_stat) {
+    header->filesize = cast(uint64, file_stat->st_size);
+    header->mtime_sec = file_stat->st_mtim.tv_sec;
+    header->mtime_nsec = file_stat->st_mtim.tv_nsec;
+    header->inode = cast(uint64, file_stat->st_ino);
+    header->hash = hash_finish(&header->state);
+}
+
+// NOTE(dgl): returns the bitset of the tags of the annotation. New tags are added to the header.
+internal uint64
+index_intern_tags(Index_Header *header, String annotation) {
+    uint64 result = 0;
+
+    Tokenizer tokenizer = {};
+    Buffer buffer = {};
+    buffer.data = annotation.data;
+    buffer.data_count = annotation.length;
+    buffer.cap = annotation.cap;
+    fill_tokenizer(&tokenizer, &buffer);
+
+    String tag = {};
+    while (annotation_next_tag(&tokenizer, &tag)) {
+        uint32 id = 0;
+        while (id < header->tag_count &&
+               !(string_length(header->tags[id]) == tag.length && string_compare(header->tags[id], tag.text, tag.length) == 0)) {
+            ++id;
+        }
+
+        if (id == header->tag_count) {
+            if (header->tag_count < INDEX_MAX_TAGS && tag.length < INDEX_TAG_SIZE) {
+                string_copy(tag.text, tag.length, header->tags[id], INDEX_TAG_SIZE);
+                header->tags[id][tag.length] = 0;
+                ++header->tag_count;
+            } else {
+                header->flags |= Index_Tags_Overflow;
+                continue;
+            }
+        }
+        result |= (cast(uint64, 1) << id);
+    }
+
+    return result;
+}
+
+internal Index_Record
+index_record_from_entry(Index_Header *header, Entry *entry, usize offset) {
+    Index_Record result = {};
+    result.offset = offset;
+    result.begin = datetime_to_epoch(&entry->begin);
+    result.begin_offset = datetime_offset_seconds(&entry->begin);
+    if (entry->end.year > 0) {
+        result.end = datetime_to_epoch(&entry->end);
+        result.end_offset = datetime_offset_seconds(&entry->end);
+    } else {
+        result.flags |= Index_Record_Open;
+    }
+    result.task_id = entry->task_id;
+    result.tags = index_intern_tags(header, entry->annotation);
+
+    return result;
+}
+
+internal void
+index_push(Mem_Arena *arena, Time_Index *index, Index_Record *record) {
+    usize count = index->header.record_count - index->record_base;
+    if (count == index->record_cap) {
+        usize new_cap = max(index->record_cap * 2, 1024);
+        if (index->records) {
+            index->records = mem_arena_resize_array(arena, Index_Record, index->records, index->record_cap, new_cap);
+        } else {
+            index->records = mem_arena_push_array(arena, Index_Record, new_cap);
+        }
+        index->record_cap = new_cap;
+    }
+
+    index->records[count] = *record;
+    ++index->header.record_count;
+}
+
+// NOTE(dgl): parses the buffer (the content of the time file) from offset to the end and adds
+// the records to the index. The hash state of the header must be the state at offset and
+// previous the record before offset (if there is one).
+internal bool32
+index_parse(Mem_Arena *arena, Buffer *buffer, usize offset, Index_Record *previous, struct stat *file_stat, Time_Index *index) {
+    Index_Header *header = &index->header;
+    usize first_record = header->record_count;
+
+    Tokenizer tokenizer = {};
+    fill_tokenizer(&tokenizer, buffer);
+    tokenizer.input.text += offset;
+    tokenizer.input.length -= offset;
+    eat_all_whitespace(&tokenizer);
+    while (!tokenizer.has_error && tokenizer.input.length > 0) {
+        usize line_offset = cast(usize, tokenizer.input.text - cast(char *, buffer->data));
+        Entry entry = parse_entry(&tokenizer);
+        if (!tokenizer.has_error) {
+            Index_Record record = index_record_from_entry(header, &entry, line_offset);
+            if (previous && record.begin < previous->begin) {
+                header->flags &= ~cast(uint32, Index_Ordered);
+            }
+            index_push(arena, index, &record);
+            previous = index->records + (header->record_count - 1 - index->record_base);
+        }
+        eat_all_whitespace(&tokenizer);
+    }
+
+    bool32 result = !tokenizer.has_error;
+    if (result) {
+        if (header->record_count > first_record) {
+            header->last_offset = index->records[header->record_count - 1 - index->record_base].offset;
+            hash_update(&header->state, cast(uint8 *, buffer->data) + offset, header->last_offset - offset);
+            header->last_state = header->state;
+            offset = header->last_offset;
+        }
+        hash_update(&header->state, cast(uint8 *, buffer->data) + offset, buffer->data_count - offset);
+        index_header_set_file(header, file_stat);
+        LOG_DEBUG("Indexed %lu of %lu entries with %u tags", cast(usize, header->record_count - first_record), cast(usize, header->record_count), header->tag_count);
+    } else {
+        LOG("Failed to index the file. Tokenizer error: %s", tokenizer.error_msg);
+    }
+
+    return result;
+}
+
+internal bool32
+index_build(Mem_Arena *arena, Buffer *buffer, struct stat *file_stat, Time_Index *index) {
+    *index = (Time_Index){};
+    index->header.magic = INDEX_MAGIC;
+    index->header.version = INDEX_VERSION;
+    index->header.flags = Index_Ordered;
+    index->header.state = hash_init();
+    index->header.last_state = index->header.state;
+
+    bool32 result = index_parse(arena, buffer, 0, 0, file_stat, index);
+    return result;
+}
+
+// NOTE(dgl): a complete index is written to a new file which replaces the old one. If we only
+// parsed the tail, the new records and the header are written in place.
+internal bool32
+index_write(File_Stats *file, Time_Index *index) {
+    char filename[MAX_FILENAME_SIZE];
+    char tmp_filename[MAX_FILENAME_SIZE];
+    index_filename(file, filename);
+    stbsp_snprintf(tmp_filename, MAX_FILENAME_SIZE, "%s~", filename);
+
+    bool32 result = false;
+    usize record_size = (index->header.record_count - index->record_base) * sizeof(Index_Record);
+    if (index->record_base > 0) {
+        int fd = open(filename, O_WRONLY);
+        if (fd >= 0) {
+            off_t record_offset = cast(off_t, sizeof(Index_Header) + index->record_base * sizeof(Index_Record));
+            result = pwrite(fd, index->records, record_size, record_offset) == cast(ssize_t, record_size) &&
+                     ftruncate(fd, record_offset + cast(off_t, record_size)) == 0 &&
+                     pwrite(fd, &index->header, sizeof(Index_Header), 0) == cast(ssize_t, sizeof(Index_Header));
+            close(fd);
+        }
+
+        if (!result) {
+            LOG("Failed to update index %s with error: %d", filename, errno);
+        }
+    } else {
+        int fd = open(tmp_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            struct iovec parts[2];
+            parts[0].iov_base = &index->header;
+            parts[0].iov_len = sizeof(Index_Header);
+            parts[1].iov_base = index->records;
+            parts[1].iov_len = record_size;
+
+            ssize_t total = cast(ssize_t, parts[0].iov_len + parts[1].iov_len);
+            result = writev(fd, parts, 2) == total;
+            close(fd);
+        }
+
+        if (result) {
+            result = rename(tmp_filename, filename) == 0;
+        } else {
+            LOG("Failed to write index %s with error: %d", tmp_filename, errno);
+            unlink(tmp_filename);
+        }
+    }
+
+    return result;
+}
+
+internal bool32
+index_read_header(int fd, Index_Header *header) {
+    bool32 result = pread(fd, header, sizeof(Index_Header), 0) == cast(ssize_t, sizeof(Index_Header)) &&
+                    header->magic == INDEX_MAGIC &&
+                    header->version == INDEX_VERSION;
+    return result;
+}
+
+// NOTE(dgl): returns true if a report without -i should use the index. Only the header is read,
+// an unreadable header is left to index_open which rebuilds the index.
+internal bool32
+index_is_preferred(File_Stats *file, usize from_sentinel, usize to_sentinel) {
+    char filename[MAX_FILENAME_SIZE];
+    index_filename(file, filename);
+
+    bool32 result = false;
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0) {
+        // NOTE(dgl): a stale index is used (and updated), range seek could not trust its order
+        Index_Header header = {};
+        struct stat file_stat = {};
+        result = !index_read_header(fd, &header) ||
+                 !(header.flags & Index_Ordered) ||
+                 to_sentinel - from_sentinel > INDEX_NARROW_RANGE_SECONDS ||
+                 stat(file->filename.text, &file_stat) != 0 ||
+                 !index_header_matches(&header, &file_stat);
+        if (!result) {
+            LOG_DEBUG("Narrow range of an ordered file, range seek is cheaper than the index");
+        }
+        close(fd);
+    }
+
+    return result;
+}
+
+// NOTE(dgl): range seek needs to know that the entries of the text are ordered. Only an index
+// which is current for the buffer (the content of the time file) can tell, see index_is_current.
+internal bool32
+index_is_ordered(File_Stats *file, Buffer *buffer) {
+    char filename[MAX_FILENAME_SIZE];
+    index_filename(file, filename);
+
+    bool32 result = false;
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0) {
+        Index_Header header = {};
+        struct stat file_stat = {};
+        result = index_read_header(fd, &header) && (header.flags & Index_Ordered) &&
+                 stat(file->filename.text, &file_stat) == 0 && index_header_matches(&header, &file_stat) &&
+                 header.filesize == buffer->data_count &&
+                 header.last_state.count == header.last_offset && header.last_offset <= header.filesize;
+
+        if (result) {
+            Hash_State state = header.last_state;
+            hash_update(&state, cast(uint8 *, buffer->data) + header.last_offset, buffer->data_count - header.last_offset);
+            result = hash_finish(&state) == header.hash;
+        }
+        close(fd);
+    }
+
+    return result;
+}
+
+// NOTE(dgl): maps the index file. The records are only valid until index_close.
+internal bool32
+index_read(File_Stats *file, Time_Index *index) {
+    char filename[MAX_FILENAME_SIZE];
+    index_filename(file, filename);
+
+    bool32 result = false;
+    *index = (Time_Index){};
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0) {
+        struct stat index_stat = {};
+        fstat(fd, &index_stat);
+        usize size = cast(usize, index_stat.st_size);
+        if (size >= sizeof(Index_Header)) {
+            void *data = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                index->mapping.data = data;
+                index->mapping.data_count = size;
+                index->mapping.cap = size;
+
+                memcpy(&index->header, data, sizeof(Index_Header));
+                index->records = cast(Index_Record *, cast(uint8 *, data) + sizeof(Index_Header));
+                index->record_cap = index->header.record_count;
+                result = index->header.magic == INDEX_MAGIC && index->header.version == INDEX_VERSION &&
+                         size == sizeof(Index_Header) + index->header.record_count * sizeof(Index_Record);
+            }
+        }
+        close(fd);
+    }
+
+    return result;
+}
+
+internal void
+index_close(Time_Index *index) {
+    unmap_file(&index->mapping);
+    index->records = 0;
+    index->record_cap = 0;
+}
+
+// NOTE(dgl): the index is current if the metadata of the file matches the header. We trust
+// the prefix and only hash the last line, the cost does not grow with the file.
+internal bool32
+index_is_current(Mem_Arena *temp_arena, Time_Index *index, int fd, struct stat *file_stat) {
+    Index_Header *header = &index->header;
+    bool32 result = index_header_matches(header, file_stat) &&
+                    header->last_state.count == header->last_offset &&
+                    header->last_offset <= header->filesize;
+
+    if (result) {
+        Hash_State state = header->last_state;
+        result = hash_update_from_file(temp_arena, fd, header->last_offset, header->filesize - header->last_offset, &state) &&
+                 hash_finish(&state) == header->hash;
+    }
+
+    return result;
+}
+
+// NOTE(dgl): the file is append mostly, only the last line changes if an entry is stopped.
+// Returns true if the buffer (the content of the time file) still starts with the content up
+// to the last line of the index, then only the tail has to be parsed again.
+internal bool32
+index_is_prefix(Time_Index *index, Buffer *buffer) {
+    Index_Header *header = &index->header;
+    bool32 result = false;
+
+    if (header->last_offset <= buffer->data_count && header->last_state.count == header->last_offset) {
+        Hash_State state = hash_init();
+        hash_update(&state, buffer->data, header->last_offset);
+        result = hash_finish(&state) == hash_finish(&header->last_state);
+    }
+
+    return result;
+}
+
+// NOTE(dgl): brings a stale index up to date while we hold the writer lock of the time file.
+// If the indexed prefix did not change we drop the last record and parse the file from its line,
+// otherwise we rebuild the whole index.
+internal bool32
+index_update(Mem_Arena *arena, Mem_Arena *temp_arena, File_Stats *file, Time_Index *index) {
+    bool32 result = false;
+
+    File_Lock lock = file_lock(temp_arena, file);
+    if (lock.fd >= 0) {
+        struct stat file_stat = {};
+        fstat(lock.fd, &file_stat);
+
+        // NOTE(dgl): another process could have updated the index while we waited for the lock
+        bool32 is_read = index_read(file, index);
+        result = is_read && index_is_current(temp_arena, index, lock.fd, &file_stat);
+
+        Buffer buffer = {};
+        File_Generation generation = {};
+        bool32 is_mapped = !result && map_entire_file(temp_arena, file, &buffer, 0, &generation);
+
+        bool32 is_rebuild = !result;
+        if (!result && is_read && index->header.record_count > 0 && index_is_prefix(index, &buffer)) {
+            Time_Index tail = {};
+            tail.header = index->header;
+            tail.header.state = tail.header.last_state;
+            tail.header.record_count -= 1;
+            tail.record_base = tail.header.record_count;
+
+            Index_Record *previous = tail.record_base > 0 ? index->records + tail.record_base - 1 : 0;
+            is_rebuild = false;
+            if (index_parse(arena, &buffer, tail.header.last_offset, previous, &file_stat, &tail)) {
+                // NOTE(dgl): if the last line was removed we have no hash state for the line
+                // of the record before.
+                is_rebuild = tail.header.record_count == tail.record_base;
+                if (!is_rebuild) {
+                    result = index_write(file, &tail);
+                }
+            }
+            index_close(index);
+            result = result && index_read(file, index);
+        }
+
+        if (is_rebuild) {
+            LOG_DEBUG("Index is missing or stale. Rebuilding it");
+            index_close(index);
+            result = index_build(arena, &buffer, &file_stat, index) && index_write(file, index);
+        }
+
+        if (is_mapped) {
+            unmap_file(&buffer);
+        }
+        file_unlock(&lock);
+    }
+
+    return result;
+}
+
+// NOTE(dgl): reads the index and checks it against the time file. The file is only read
+// completely if the index is stale, see index_update.
+internal bool32
+index_open(Mem_Arena *arena, Mem_Arena *temp_arena, File_Stats *file, Time_Index *index) {
+    bool32 result = false;
+    int fd = open(file->filename.text, O_RDONLY);
+    if (fd >= 0) {
+        struct stat file_stat = {};
+        result = fstat(fd, &file_stat) == 0 && index_read(file, index) &&
+                 index_is_current(temp_arena, index, fd, &file_stat);
+        close(fd);
+    }
+
+    if (!result) {
+        index_close(index);
+        result = index_update(arena, temp_arena, file, index);
+    }
+
+    return result;
+}
+
+// NOTE(dgl): adds the entries of the index in the range to the table. Returns false if the tag
+// filter cannot be answered from the index.
+internal bool32
+index_fill_table(Mem_Arena *arena, Commandline *ctx, Time_Index *index, usize from_sentinel, usize to_sentinel, Entry_Table *table) {
+    Index_Header *header = &index->header;
+    // NOTE(dgl): the records have no annotations, we cannot sort by tag
+    bool32 result = !(table->has_tags && (header->flags & Index_Tags_Overflow)) &&
+                    ctx->report.sort != Report_Sort_Tag;
+
+    if (result) {
+        // NOTE(dgl): the slot of the filter for every tag bit of the records
+        Report_Filter *filter = &ctx->report.filter;
+        uint64 filter_tags = 0;
+        uint32 bit_slots[INDEX_MAX_TAGS];
+        for (uint32 id = 0; id < header->tag_count; ++id) {
+            bit_slots[id] = filter_tag_slot(filter, string_from_c_str(header->tags[id]));
+            if (bit_slots[id] != cast(uint32, -1)) {
+                filter_tags |= (cast(uint64, 1) << id);
+            }
+        }
+
+        // NOTE(dgl): the tag bits of the records are mapped to the ids of the table
+        uint32 tag_ids[INDEX_MAX_TAGS];
+        if (table->has_tags) {
+            for (uint32 id = 0; id < header->tag_count; ++id) {
+                tag_ids[id] = tag_dictionary_intern(arena, &table->tags, string_from_c_str(header->tags[id]));
+            }
+        }
+
+        // NOTE(dgl): ordered records only have to be read from the first record in the range
+        usize first = 0;
+        usize last = header->record_count;
+        if (header->flags & Index_Ordered) {
+            usize count = last;
+            while (count > 0) {
+                usize half = count / 2;
+                if (index->records[first + half].begin <= from_sentinel) {
+                    first += half + 1;
+                    count -= half + 1;
+                } else {
+                    count = half;
+                }
+            }
+        }
+
+        for (usize index_record = first; index_record < last; ++index_record) {
+            Index_Record *record = index->records + index_record;
+            if ((header->flags & Index_Ordered) && record->begin >= to_sentinel) {
+                break;
+            }
+
+            bool32 is_match = record->begin > from_sentinel && record->begin < to_sentinel;
+            if (is_match && filter->code_count > 0) {
+                filter_clear(filter);
+                for (uint64 bits = record->tags & filter_tags; bits; bits &= bits - 1) {
+                    filter_set(filter, bit_slots[__builtin_ctzll(bits)]);
+                }
+                is_match = filter_eval(filter);
+            }
+
+            if (is_match) {
+                if (table->count == table->cap) {
+                    entry_table_grow(arena, table, max(table->cap * 2, 1024));
+                }
+
+                usize entry = table->count++;
+                table->begins[entry] = record->begin;
+                table->ends[entry] = record->end;
+                table->begin_offsets[entry] = record->begin_offset;
+                table->end_offsets[entry] = record->end_offset;
+                table->task_ids[entry] = record->task_id;
+                table->annotation_offsets[entry] = 0;
+                table->annotation_lengths[entry] = 0;
+                table->is_open[entry] = (record->flags & Index_Record_Open) != 0;
+                if (table->has_tags) {
+                    table->tag_offsets[entry] = cast(uint32, table->tag_id_count);
+                    table->tag_counts[entry] = 0;
+                    for (uint64 bits = record->tags; bits; bits &= bits - 1) {
+                        entry_table_push_tag(arena, table, tag_ids[__builtin_ctzll(bits)]);
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+// NOTE(dgl): start and continue appended the line of the entry (and maybe a newline before it)
+// to the file. We only update an index which was valid for the file before the append.
+internal void
+index_append(File_Stats *file, struct stat *before, Entry *entry, Buffer *newline, Buffer *line) {
+    char filename[MAX_FILENAME_SIZE];
+    index_filename(file, filename);
+
+    int fd = open(filename, O_RDWR);
+    if (fd >= 0) {
+        Index_Header header = {};
+        struct stat after = {};
+        if (index_read_header(fd, &header) && index_header_matches(&header, before) &&
+            stat(file->filename.text, &after) == 0) {
+            hash_update(&header.state, newline->data, newline->data_count);
+            header.last_offset = header.state.count;
+            header.last_state = header.state;
+            hash_update(&header.state, line->data, line->data_count);
+            index_header_set_file(&header, &after);
+
+            Index_Record record = index_record_from_entry(&header, entry, header.last_offset);
+            Index_Record previous = {};
+            if ((header.flags & Index_Ordered) && header.record_count > 0 &&
+                (pread(fd, &previous, sizeof(previous), cast(off_t, sizeof(Index_Header) + (header.record_count - 1) * sizeof(Index_Record))) != cast(ssize_t, sizeof(previous)) ||
+                 record.begin < previous.begin)) {
+                header.flags &= ~cast(uint32, Index_Ordered);
+            }
+
+            off_t record_offset = cast(off_t, sizeof(Index_Header) + header.record_count * sizeof(Index_Record));
+            ++header.record_count;
+            if (pwrite(fd, &record, sizeof(record), record_offset) != cast(ssize_t, sizeof(record)) ||
+                pwrite(fd, &header, sizeof(header), 0) != cast(ssize_t, sizeof(header))) {
+                LOG("Failed to update index %s with error: %d", filename, errno);
+            }
+        } else {
+            LOG_DEBUG("Index %s is stale, the next report rebuilds it", filename);
+        }
+        close(fd);
+    }
+}
+
+// NOTE(dgl): batch and the server do not update the index, but if they added an entry before the
+// last one, the file is not ordered any more and range seek must not trust the index.
+internal void
+index_clear_ordered(File_Stats *file) {
+    char filename[MAX_FILENAME_SIZE];
+    index_filename(file, filename);
+
+    int fd = open(filename, O_RDWR);
+    if (fd >= 0) {
+        Index_Header header = {};
+        if (index_read_header(fd, &header) && (header.flags & Index_Ordered)) {
+            header.flags &= ~cast(uint32, Index_Ordered);
+            if (pwrite(fd, &header, sizeof(header), 0) != cast(ssize_t, sizeof(header))) {
+                LOG("Failed to update index %s with error: %d", filename, errno);
+            }
+        }
+        close(fd);
+    }
+}
+
+// NOTE(dgl): stop changed the last line of the file. We continue the hash from the stored state
+// at the beginning of the last line.
+internal void
+index_close_last(Mem_Arena *temp_arena, File_Stats *file, struct stat *before, Entry *entry, usize line_offset) {
+    char filename[MAX_FILENAME_SIZE];
+    index_filename(file, filename);
+
+    int fd = open(filename, O_RDWR);
+    if (fd >= 0) {
+        Index_Header header = {};
+        Index_Record record = {};
+        struct stat after = {};
+        off_t record_offset = 0;
+        bool32 is_valid = index_read_header(fd, &header) && index_header_matches(&header, before) &&
+                          header.record_count > 0 && header.last_offset == line_offset;
+        if (is_valid) {
+            record_offset = cast(off_t, sizeof(Index_Header) + (header.record_count - 1) * sizeof(Index_Record));
+            is_valid = pread(fd, &record, sizeof(record), record_offset) == cast(ssize_t, sizeof(record)) && record.offset == line_offset;
+        }
+
+        int file_fd = open(file->filename.text, O_RDONLY);
+        if (is_valid && file_fd >= 0 && fstat(file_fd, &after) == 0) {
+            record.end = datetime_to_epoch(&entry->end);
+            record.end_offset = datetime_offset_seconds(&entry->end);
+            record.flags &= ~cast(uint32, Index_Record_Open);
+
+            header.state = header.last_state;
+            is_valid = hash_update_from_file(temp_arena, file_fd, line_offset, cast(usize, after.st_size) - line_offset, &header.state);
+            index_header_set_file(&header, &after);
+
+            if (!is_valid ||
+                pwrite(fd, &record, sizeof(record), record_offset) != cast(ssize_t, sizeof(record)) ||
+                pwrite(fd, &header, sizeof(header), 0) != cast(ssize_t, sizeof(header))) {
+                LOG("Failed to update index %s with error: %d", filename, errno);
+            }
+        } else {
+            LOG_DEBUG("Index %s is stale, the next report rebuilds it", filename);
+        }
+
+        if (file_fd >= 0) {
+            close(file_fd);
+        }
+        close(fd);
+    }
+}
+
+//
+// Commandline
+//
+
+internal void
+commandline_parse_start_cmd(Commandline *ctx, char** args, int args_count) {
+    ctx->start.task_id = -1;
+    int32 cursor = 0;
+
+    while(cursor < args_count &&
+          string_compare("-", args[cursor], 1) == 0) {
+        char *arg = args[cursor++];
+        if (string_compare("-t", arg, 2) == 0) {
+            char *number = args[cursor++];
+            ctx->start.task_id = string_to_int32(number, cast(int32, string_length(number)));
+        } else {
+            ++cursor;
+        }
+    }
+
+    // NOTE(dgl): everything after the flags is considered annotation
+    if(cursor < args_count) {
+        usize required_memory = 0;
+        int32 start_count = cursor;
+
+        while(cursor < args_count) {
+            required_memory += string_length(args[cursor++]);
+            required_memory += 1; // space or nullbyte
+        }
+        ctx->start.annotation.cap = required_memory;
+        ctx->start.annotation.length = required_memory - 1;
+        ctx->start.annotation.text = mem_arena_push_array(ctx->arena, char, required_memory);
+
+        char *dest = ctx->start.annotation.text;
+        cursor = start_count;
+        // NOTE(dgl): each annotation is a separate arg therefore we concat them and add a space between
+        while(cursor < args_count) {
+            char *annotation = args[cursor++];
+            usize length = string_length(annotation);
+            string_copy(annotation, length, dest, length);
+            dest += length;
+            *dest++ = ' ';
+        }
+
+        ctx->start.annotation.text[required_memory] = 0;
+    } else {
+        ctx->start.annotation = string_from_c_str("");
+    }
+}
+
+#if DEBUG
+internal void
+commandline_parse_test_cmd(Commandline *ctx, char** args, int args_count) {
+    int32 cursor = 0;
+    char **words = mem_arena_push_array(ctx->arena, char *, max(args_count, 1));
+    int32 word_count = 0;
+
+    ctx->report.type = Report_Type_Today;
+    while(cursor < args_count) {
+        char *arg = args[cursor++];
+        if (filter_is_word(arg)) {
+            words[word_count++] = arg;
+        }
+    }
+
+    if (word_count > 0 && !filter_compile(ctx->arena, words, word_count, &ctx->report.filter)) {
+        ctx->is_valid = false;
+    }
+}
+#endif
+
+// NOTE(dgl): parses yyyy-mm-dd or yyyy-mm-ddThh[:mm[:ss]][+|-]hh[:mm[:ss]]. A date without time
+// is in the timezone of now and starts at midnight. If it is the end of the range, the range
+// includes the whole day.
+internal bool32
+commandline_parse_report_date(Commandline *ctx, char *arg, bool32 is_end, Datetime *datetime) {
+    bool32 has_time = false;
+    for (char *c = arg; *c; ++c) {
+        has_time |= *c == 'T';
+    }
+
+    Tokenizer tokenizer = {};
+    tokenizer.input = string_from_c_str(arg);
+    tokenizer.base = tokenizer.input.text;
+    if (has_time) {
+        *datetime = parse_datetime_general(&tokenizer);
+    } else {
+        *datetime = parse_date(&tokenizer);
+        datetime->offset_sign = ctx->now.offset_sign;
+        datetime->offset_hour = ctx->now.offset_hour;
+        datetime->offset_minute = ctx->now.offset_minute;
+        datetime->offset_second = ctx->now.offset_second;
+        if (is_end && !tokenizer.has_error) {
+            datetime->day += 1;
+            datetime_normalize(datetime);
+        }
+    }
+
+    bool32 result = !tokenizer.has_error;
+    if (!result) {
+        LOG("Invalid date %s: %s", arg, tokenizer.error_msg);
+    }
+
+    return result;
+}
+
+internal void
+commandline_parse_report_cmd(Commandline *ctx, char** args, int args_count) {
+    int32 cursor = 0;
+    int32 date_count = 0;
+    char **words = mem_arena_push_array(ctx->arena, char *, max(args_count, 1));
+    int32 word_count = 0;
+
+    ctx->report.type = Report_Type_Today;
+    ctx->report.sort = Report_Sort_Begin;
+    ctx->report.group_by = Report_Group_None;
+    while(cursor < args_count) {
+        char *arg = args[cursor++];
+        if (filter_is_word(arg)) {
+            words[word_count++] = arg;
+        } else if (string_compare("--sort=", arg, 7) == 0) {
+            char *order = arg + 7;
+            if (string_compare("begin", order, 6) == 0) {
+                ctx->report.sort = Report_Sort_Begin;
+            } else if (string_compare("duration", order, 9) == 0) {
+                ctx->report.sort = Report_Sort_Duration;
+            } else if (string_compare("task", order, 5) == 0) {
+                ctx->report.sort = Report_Sort_Task;
+            } else if (string_compare("tag", order, 4) == 0) {
+                ctx->report.sort = Report_Sort_Tag;
+            } else {
+                LOG("Invalid sort order %s - expected begin, duration, task or tag", order);
+                ctx->is_valid = false;
+            }
+        } else if (string_compare("--by=", arg, 5) == 0) {
+            char *group = arg + 5;
+            if (*group == '@' || string_compare("context", group, 8) == 0) {
+                ctx->report.group_by = Report_Group_Context;
+            } else if (*group == '+' || string_compare("project", group, 8) == 0) {
+                ctx->report.group_by = Report_Group_Project;
+            } else if (string_compare("task", group, 5) == 0) {
+                ctx->report.group_by = Report_Group_Task;
+            } else {
+                LOG("Invalid group %s - expected @context, +project or task", group);
+                ctx->is_valid = false;
+            }
+        } else if (*arg >= '0' && *arg <= '9') {
+            if (date_count < 2) {
+                Datetime *datetime = date_count == 0 ? &ctx->report.from : &ctx->report.to;
+                if (commandline_parse_report_date(ctx, arg, date_count == 1, datetime)) {
+                    ctx->report.type = Report_Type_Custom;
+                } else {
+                    ctx->is_valid = false;
+                }
+                ++date_count;
+            } else {
+                LOG("A range has two dates. Date %s will be ignored", arg);
+            }
+        } else if ((string_compare("yes", arg, 3) == 0)) {
+            ctx->report.type = Report_Type_Yesterday;
+        } else if ((string_compare("m", arg, 1) == 0)) {
+            ctx->report.type = Report_Type_Month;
+        } else if ((string_compare("lastm", arg, 5) == 0)) {
+            ctx->report.type = Report_Type_Last_Month;
+        } else if ((string_compare("w", arg, 1) == 0)) {
+            ctx->report.type = Report_Type_Week;
+        } else if ((string_compare("lastw", arg, 5) == 0)) {
+            ctx->report.type = Report_Type_Last_Week;
+        } else if ((string_compare("yea", arg, 3) == 0)) {
+            ctx->report.type = Report_Type_Year;
+        } else if ((string_compare("lasty", arg, 5) == 0)) {
+            ctx->report.type = Report_Type_Last_Year;
+        }
+    }
+
+    if (word_count > 0 && !filter_compile(ctx->arena, words, word_count, &ctx->report.filter)) {
+        ctx->is_valid = false;
+    }
+
+    Datetime now = ctx->now;
+    if (ctx->report.type == Report_Type_Custom) {
+        // NOTE(dgl): without an end the range goes up to now
+        if (date_count < 2) {
+            ctx->report.to = now;
+        }
+    } else {
+        ctx->report.from = datetime_to_beginning_of(ctx->report.type, &now);
+        ctx->report.to = now;
+        if (ctx->report.type > Report_Type_Set_End_Date) {
+            ctx->report.to = datetime_to_end_of(ctx->report.type, &now);
+        }
+    }
+
+    LOG_DEBUG("Report type: %d", ctx->report.type);
+    LOG_DEBUG("Report from: ");
+    print_timestamp(&ctx->report.from);
+    LOG_DEBUG("Report to: ");
+    print_timestamp(&ctx->report.to);
+}
+
+internal void
+commandline_parse_csv_cmd(Commandline *ctx, char** args, int args_count) {
+
+}
+
+internal void
+commandline_parse(Mem_Arena *arena, Commandline *ctx, char** args, int args_count) {
+    ctx->arena = arena;
+    ctx->is_valid = true;
+    ctx->now = get_timestamp();
+
+    File_Stats home = get_file_stats(arena, string_from_c_str("~/time.txt"));
+    File_Stats local = get_file_stats(arena, string_from_c_str("./time.txt"));
+    ctx->file = local;
+    if (!ctx->file.exists) {
+        ctx->file = home;
+    }
+
+    struct winsize w;
+    ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
+
+    ctx->window_rows = w.ws_row;
+    ctx->window_columns = w.ws_col;
+
+    // NOTE(dgl): default command type (if nothing else found)
+    ctx->command_type = Command_Type_Report;
+
+    int cursor = 1;
+    // NOTE(dgl): without args
+    if (args_count == 1) {
+        // TODO(dgl): tbd
+    } else {
+        while (cursor < args_count) {
+            char *arg = args[cursor++];
+
+            if (string_compare("-p", arg, 2) == 0) {
+                ctx->input_flags |= Input_Populate;
+            } else if (string_compare("-s", arg, 2) == 0) {
+                ctx->input_flags |= Input_Stream;
+            } else if (string_compare("-i", arg, 2) == 0) {
+                ctx->input_flags |= Input_Index;
+            } else if (string_compare("-j", arg, 2) == 0) {
+                if (cursor < args_count) {
+                    char *number = args[cursor++];
+                    int32 thread_count = string_to_int32(number, cast(int32, string_length(number)));
+                    ctx->thread_count = cast(uint32, max(thread_count, 0));
+                } else {
+                    ctx->is_valid = false;
+                }
+            } else if (string_compare("-f", arg, 2) == 0) {
+                if (cursor < args_count) {
+                    char *filename = args[cursor++];
+                    ctx->file = get_file_stats(arena, string_from_c_str(filename));
+                    // TODO(dgl): if a file flag was provided and the file
+                    // does not exist, we should create it.
+                } else {
+                    ctx->is_valid = false;
+                }
+            } else if (string_compare("sta", arg, 3) == 0) {
+                ctx->command_type = Command_Type_Start;
                 break;
             } else if (string_compare("con", arg, 3) == 0) {
                 ctx->command_type = Command_Type_Continue;
@@ -1438,6 +4330,18 @@ commandline_parse(Mem_Arena *arena, Commandline *ctx, char** args, int args_coun
             } else if (string_compare("csv", arg, 3) == 0) {
                 ctx->command_type = Command_Type_CSV;
                 break;
+            } else if (string_compare("bat", arg, 3) == 0) {
+                ctx->command_type = Command_Type_Batch;
+                break;
+            } else if (string_compare("ser", arg, 3) == 0) {
+                ctx->command_type = Command_Type_Serve;
+                break;
+            } else if (string_compare("imp", arg, 3) == 0) {
+                ctx->command_type = Command_Type_Import;
+                break;
+            } else if (string_compare("exp", arg, 3) == 0) {
+                ctx->command_type = Command_Type_Export;
+                break;
 #if DEBUG
             } else if (string_compare("gen", arg, 3) == 0) {
                 ctx->command_type = Command_Type_Generate;
@@ -1445,94 +4349,1977 @@ commandline_parse(Mem_Arena *arena, Commandline *ctx, char** args, int args_coun
             } else if (string_compare("test", arg, 4) == 0) {
                 ctx->command_type = Command_Type_Test;
                 break;
+            } else if (string_compare("bench", arg, 5) == 0) {
+                ctx->command_type = Command_Type_Bench;
+                break;
+#endif
+            }
+        }
+
+        args += cursor;
+        args_count -= cursor;
+        cursor = 0;
+    }
+
+    if (ctx->is_valid) {
+        PRINT_DEBUG("Running ttime with these args:\n\tfilename=%s\n", string_to_c_str(ctx->arena, ctx->file.filename));
+        switch (ctx->command_type) {
+            case Command_Type_Start: {
+                commandline_parse_start_cmd(ctx, args, args_count);
+                PRINT_DEBUG("\tcommand=start\n\ttask_id=%d\n\tannotation=%s\n", ctx->start.task_id, string_to_c_str(ctx->arena, ctx->start.annotation));
+            } break;
+            case Command_Type_Continue: {
+                PRINT_DEBUG("\tcommand=continue\n");
+            } break;
+            case Command_Type_Stop: {
+                PRINT_DEBUG("\tcommand=stop\n");
+            } break;
+            case Command_Type_Report: {
+                commandline_parse_report_cmd(ctx, args, args_count);
+                PRINT_DEBUG("\tcommand=report\n");
+            } break;
+            case Command_Type_CSV: {
+                commandline_parse_csv_cmd(ctx, args, args_count);
+                PRINT_DEBUG("\tcommand=csv\n");
+            } break;
+            case Command_Type_Batch: {
+                if (args_count > 0) {
+                    ctx->batch.input = string_from_c_str(args[0]);
+                }
+                PRINT_DEBUG("\tcommand=batch\n");
+            } break;
+            case Command_Type_Serve: {
+                PRINT_DEBUG("\tcommand=serve\n");
+            } break;
+            case Command_Type_Import: {
+                if (args_count > 0) {
+                    ctx->convert.filename = string_from_c_str(args[0]);
+                } else {
+                    ctx->is_valid = false;
+                }
+                PRINT_DEBUG("\tcommand=import\n");
+            } break;
+            case Command_Type_Export: {
+                if (args_count > 0) {
+                    ctx->convert.filename = string_from_c_str(args[0]);
+                } else {
+                    ctx->is_valid = false;
+                }
+                PRINT_DEBUG("\tcommand=export\n");
+            } break;
+#if DEBUG
+            case Command_Type_Test: {
+                commandline_parse_test_cmd(ctx, args, args_count);
+                PRINT_DEBUG("\tcommand=test\n");
+            } break;
+            case Command_Type_Bench: {
+                PRINT_DEBUG("\tcommand=bench\n");
+            } break;
+#endif
+            default:
+                // NOTE(dgl): something went wrong
+                ctx->is_valid = false;
+        }
+    }
+
+    // NOTE(dgl): import creates the file
+    if (!ctx->file.exists && ctx->command_type != Command_Type_Import) {
+        ctx->is_valid = false;
+        LOG("File %s does not exist. To create it automatically use the -f flag", string_to_c_str(ctx->arena, ctx->file.filename));
+    }
+}
+
+//
+// Sorting
+//
+
+// NOTE(dgl): sorts by sort_key - key_min with pass_count passes of digit_bits bits. The
+// sorted entries are always in first.
+internal void
+sort_radix(Sort_Entry *first, Sort_Entry *temp, uint32 entry_count, uint64 key_min, uint32 digit_bits, uint32 pass_count) {
+    assert(digit_bits <= SORT_MAX_DIGIT_BITS, "Digit too large. Max bits: %d, got: %u", SORT_MAX_DIGIT_BITS, digit_bits);
+
+    Sort_Entry *source = first;
+    Sort_Entry *dest = temp;
+    uint32 bucket_count = 0x1 << digit_bits;
+    uint32 digit_mask = bucket_count - 1;
+    uint32 sort_key_offset[0x1 << SORT_MAX_DIGIT_BITS];
+    for(uint32 pass = 0; pass < pass_count; ++pass) {
+        uint32 shift = pass * digit_bits;
+        memset(sort_key_offset, 0, bucket_count * sizeof(uint32));
+
+        // NOTE(casey): First pass - count how many of each key
+        for(uint32 index = 0; index < entry_count; ++index) {
+            uint64 radix_value = source[index].sort_key - key_min;
+            uint32 radix_piece = cast(uint32, radix_value >> shift) & digit_mask;
+            ++sort_key_offset[radix_piece];
+        }
+
+        // NOTE(casey): Change counts to offsets
+        uint32 total = 0;
+        for(uint32 sort_key_index = 0;
+            sort_key_index < bucket_count;
+            ++sort_key_index) {
+            uint32 count = sort_key_offset[sort_key_index];
+            sort_key_offset[sort_key_index] = total;
+            total += count;
+        }
+
+        // NOTE(casey): Second pass - place elements into the right location
+        for(uint32 index = 0; index < entry_count; ++index) {
+            uint64 radix_value = source[index].sort_key - key_min;
+            uint32 radix_piece = cast(uint32, radix_value >> shift) & digit_mask;
+            dest[sort_key_offset[radix_piece]++] = source[index];
+        }
+
+        Sort_Entry *swap_temp = dest;
+        dest = source;
+        source = swap_temp;
+    }
+
+    if (source != first) {
+        memcpy(first, source, entry_count * sizeof(Sort_Entry));
+    }
+}
+
+//
+// Parallel radix sort
+// NOTE(dgl): every thread owns a contiguous chunk of the entries. For each digit the threads
+// count the digits of their chunk into their own histogram. After a barrier every thread
+// computes where its entries go: the entries of all smaller digits plus the entries with the
+// same digit in the chunks before. Then the threads scatter their chunk. Chunks are placed in
+// order, therefore the sort stays stable. The second barrier makes sure that nobody reads the
+// source or the histograms of the pass anymore.
+//
+
+typedef struct {
+    Sort_Entry        *first;
+    Sort_Entry        *temp;
+    uint32             entry_count;
+    uint64             key_min;
+    uint32             digit_bits;
+    uint32             pass_count;
+
+    uint32             thread_count;
+    uint32            *counts; // NOTE(dgl): one histogram with 2^digit_bits buckets per thread
+    pthread_barrier_t  barrier;
+    pthread_mutex_t    mutex;
+    pthread_cond_t     started;
+    bool32             is_started;
+} Sort_Parallel;
+
+typedef struct {
+    Sort_Parallel *sort;
+    uint32         thread_index;
+} Sort_Worker;
+
+internal void
+sort_radix_worker(Sort_Parallel *sort, uint32 thread_index) {
+    uint32 bucket_count = 0x1 << sort->digit_bits;
+    uint32 digit_mask = bucket_count - 1;
+    uint32 begin = cast(uint32, (cast(uint64, sort->entry_count) * thread_index) / sort->thread_count);
+    uint32 end = cast(uint32, (cast(uint64, sort->entry_count) * (thread_index + 1)) / sort->thread_count);
+    uint32 *counts = sort->counts + thread_index * bucket_count;
+    uint32 sort_key_offset[0x1 << SORT_MAX_DIGIT_BITS];
+
+    Sort_Entry *source = sort->first;
+    Sort_Entry *dest = sort->temp;
+    for(uint32 pass = 0; pass < sort->pass_count; ++pass) {
+        uint32 shift = pass * sort->digit_bits;
+        memset(counts, 0, bucket_count * sizeof(uint32));
+        for(uint32 index = begin; index < end; ++index) {
+            uint64 radix_value = source[index].sort_key - sort->key_min;
+            uint32 radix_piece = cast(uint32, radix_value >> shift) & digit_mask;
+            ++counts[radix_piece];
+        }
+
+        pthread_barrier_wait(&sort->barrier);
+
+        uint32 total = 0;
+        for(uint32 sort_key_index = 0; sort_key_index < bucket_count; ++sort_key_index) {
+            for (uint32 thread = 0; thread < sort->thread_count; ++thread) {
+                if (thread == thread_index) {
+                    sort_key_offset[sort_key_index] = total;
+                }
+                total += sort->counts[thread * bucket_count + sort_key_index];
+            }
+        }
+
+        for(uint32 index = begin; index < end; ++index) {
+            uint64 radix_value = source[index].sort_key - sort->key_min;
+            uint32 radix_piece = cast(uint32, radix_value >> shift) & digit_mask;
+            dest[sort_key_offset[radix_piece]++] = source[index];
+        }
+
+        pthread_barrier_wait(&sort->barrier);
+
+        Sort_Entry *swap_temp = dest;
+        dest = source;
+        source = swap_temp;
+    }
+
+    if (source != sort->first) {
+        memcpy(sort->first + begin, source + begin, (end - begin) * sizeof(Sort_Entry));
+    }
+}
+
+internal void *
+sort_radix_thread(void *data) {
+    Sort_Worker *worker = cast(Sort_Worker *, data);
+    Sort_Parallel *sort = worker->sort;
+
+    // NOTE(dgl): the number of threads is known after all of them were created
+    pthread_mutex_lock(&sort->mutex);
+    while (!sort->is_started) {
+        pthread_cond_wait(&sort->started, &sort->mutex);
+    }
+    pthread_mutex_unlock(&sort->mutex);
+
+    sort_radix_worker(sort, worker->thread_index);
+    return 0;
+}
+
+// NOTE(dgl): same result as sort_radix with up to thread_count threads. If we cannot create a
+// thread the chunks are split between the threads we have.
+internal void
+sort_radix_parallel(Mem_Arena *temp_arena, Sort_Entry *first, Sort_Entry *temp, uint32 entry_count, uint64 key_min, uint32 digit_bits, uint32 pass_count, uint32 thread_count) {
+    assert(digit_bits <= SORT_MAX_DIGIT_BITS, "Digit too large. Max bits: %d, got: %u", SORT_MAX_DIGIT_BITS, digit_bits);
+    thread_count = min(max(thread_count, 1), MAX_SORT_THREADS);
+
+    Sort_Parallel sort = {};
+    sort.first = first;
+    sort.temp = temp;
+    sort.entry_count = entry_count;
+    sort.key_min = key_min;
+    sort.digit_bits = digit_bits;
+    sort.pass_count = pass_count;
+    pthread_mutex_init(&sort.mutex, 0);
+    pthread_cond_init(&sort.started, 0);
+
+    pthread_t threads[MAX_SORT_THREADS];
+    Sort_Worker workers[MAX_SORT_THREADS];
+    uint32 running_count = 0;
+    for (uint32 index = 1; index < thread_count; ++index) {
+        Sort_Worker *worker = workers + running_count;
+        worker->sort = &sort;
+        worker->thread_index = running_count + 1;
+        if (pthread_create(threads + running_count, 0, sort_radix_thread, worker) == 0) {
+            ++running_count;
+        } else {
+            LOG_DEBUG("Failed to create sort thread %u", index);
+        }
+    }
+
+    Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+    {
+        // NOTE(dgl): the first chunk is sorted on this thread
+        sort.thread_count = running_count + 1;
+        sort.counts = mem_arena_push_array(tmp_arena.arena, uint32, sort.thread_count << digit_bits);
+        pthread_barrier_init(&sort.barrier, 0, sort.thread_count);
+
+        pthread_mutex_lock(&sort.mutex);
+        sort.is_started = true;
+        pthread_cond_broadcast(&sort.started);
+        pthread_mutex_unlock(&sort.mutex);
+
+        sort_radix_worker(&sort, 0);
+
+        for (uint32 index = 0; index < running_count; ++index) {
+            pthread_join(threads[index], 0);
+        }
+        pthread_barrier_destroy(&sort.barrier);
+    }
+    mem_arena_end_temp(tmp_arena);
+
+    pthread_cond_destroy(&sort.started);
+    pthread_mutex_destroy(&sort.mutex);
+}
+
+// NOTE(dgl): stable insertion sort. It gives up after max_moves moved entries and returns
+// false, the entries are still a permutation of the input in that case.
+internal bool32
+sort_insertion(Sort_Entry *entries, uint32 entry_count, usize max_moves) {
+    bool32 result = true;
+
+    usize moves = 0;
+    for (uint32 index = 1; index < entry_count && result; ++index) {
+        Sort_Entry entry = entries[index];
+        uint32 cursor = index;
+        while (cursor > 0 && entries[cursor - 1].sort_key > entry.sort_key) {
+            entries[cursor] = entries[cursor - 1];
+            --cursor;
+        }
+        entries[cursor] = entry;
+
+        moves += index - cursor;
+        result = moves <= max_moves;
+    }
+
+    return result;
+}
+
+// NOTE(dgl): the passes for keys with bits bits. Wide digits (up to SORT_MAX_DIGIT_BITS, the
+// histogram still fits into L1) only pay off if they save a pass and we need at most two of
+// them. With more passes the scatter into 2048 buckets is slower than into 256 (see sort_bench).
+internal inline void
+sort_radix_passes(uint32 bits, uint32 *digit_bits, uint32 *pass_count) {
+    *pass_count = (bits + SORT_MAX_DIGIT_BITS - 1) / SORT_MAX_DIGIT_BITS;
+    if (*pass_count > 2) {
+        *pass_count = (bits + 7) / 8;
+    }
+    *digit_bits = *pass_count > 0 ? (bits + *pass_count - 1) / *pass_count : 0;
+}
+
+// NOTE(dgl): entries from the time file are almost always in order, therefore we first check
+// the order and the key range in one pass. Sorted entries are left alone, nearly sorted entries
+// are patched with an insertion sort and the radix sort only looks at the bits of the key range.
+internal void
+sort_adaptive(Mem_Arena *temp_arena, Sort_Entry *entries, uint32 entry_count, uint32 thread_count) {
+    if (entry_count > 1) {
+        uint32 descents = 0;
+        uint64 key_min = entries[0].sort_key;
+        uint64 key_max = key_min;
+        for (uint32 index = 1; index < entry_count; ++index) {
+            uint64 key = entries[index].sort_key;
+            descents += key < entries[index - 1].sort_key;
+            key_min = min(key_min, key);
+            key_max = max(key_max, key);
+        }
+
+        bool32 is_sorted = descents == 0;
+        if (!is_sorted && (entry_count <= SORT_INSERTION_MAX_COUNT || descents <= entry_count / SORT_NEARLY_SORTED_RATIO)) {
+            // NOTE(dgl): insertion sort only pays off if the entries are close to their place
+            usize max_moves = entry_count <= SORT_INSERTION_MAX_COUNT ? cast(usize, -1) : cast(usize, entry_count) * SORT_INSERTION_MOVES;
+            is_sorted = sort_insertion(entries, entry_count, max_moves);
+        }
+
+        if (!is_sorted) {
+            // NOTE(dgl): key_max > key_min, there is at least one descent
+            uint32 bits = 64 - cast(uint32, __builtin_clzll(key_max - key_min));
+            uint32 digit_bits = 0;
+            uint32 pass_count = 0;
+            sort_radix_passes(bits, &digit_bits, &pass_count);
+
+            Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+            {
+                Sort_Entry *sort_memory = mem_arena_push_array(tmp_arena.arena, Sort_Entry, entry_count);
+                thread_count = min(thread_count_or_cores(thread_count), entry_count / SORT_PARALLEL_MIN_COUNT);
+                if (thread_count > 1) {
+                    sort_radix_parallel(tmp_arena.arena, entries, sort_memory, entry_count, key_min, digit_bits, pass_count, thread_count);
+                } else {
+                    sort_radix(entries, sort_memory, entry_count, key_min, digit_bits, pass_count);
+                }
+            }
+            mem_arena_end_temp(tmp_arena);
+        }
+    }
+}
+
+// NOTE(dgl): sorts the entries in place. The temporary memory is released afterwards.
+internal void
+sort_by_key(Mem_Arena *temp_arena, Sort_Entry *entries, uint32 entry_count, uint32 thread_count) {
+    sort_adaptive(temp_arena, entries, entry_count, thread_count);
+
+#if DEBUG
+    for (uint32 index = 0; index + 1 < entry_count; ++index) {
+        Sort_Entry *a = entries + index;
+        Sort_Entry *b = a + 1;
+
+        assert(a->sort_key <= b->sort_key, "Array not correctly sorted at index %d - a: %llu, b: %llu", index, a->sort_key, b->sort_key);
+    }
+#endif
+}
+
+// NOTE(dgl): orders the entries of the table by begin and then by the key of the report sort.
+// Both sorts are stable, entries with the same key stay in chronological order. The keys have
+// 64 bits, therefore a custom range can be wider than 2^32 seconds.
+internal Sort_Entry *
+report_sort_table(Mem_Arena *arena, Mem_Arena *temp_arena, Entry_Table *table, Report_Sort sort, usize from_sentinel, Datetime *now, uint32 thread_count) {
+    uint32 entry_count = cast(uint32, table->count);
+    Sort_Entry *result = mem_arena_push_array(arena, Sort_Entry, entry_count);
+    for (uint32 index = 0; index < entry_count; ++index) {
+        assert(from_sentinel < table->begins[index], "begin cannot be in the future, for sorting");
+        result[index].sort_key = table->begins[index] - from_sentinel;
+        result[index].index = cast(int32, index);
+    }
+
+    sort_by_key(temp_arena, result, entry_count, thread_count);
+
+    if (sort != Report_Sort_Begin && entry_count > 1) {
+        Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+        {
+            // NOTE(dgl): the key of a tag is the rank of the first tag of the entry. Entries
+            // without a tag come last.
+            uint32 *tag_ranks = 0;
+            if (sort == Report_Sort_Tag) {
+                assert(table->has_tags, "The table has no tags");
+                tag_ranks = tag_dictionary_ranks(tmp_arena.arena, &table->tags);
+            }
+
+            usize now_epoch = datetime_to_epoch(now);
+            for (uint32 index = 0; index < entry_count; ++index) {
+                usize entry = cast(usize, result[index].index);
+                uint64 key = 0;
+                switch (sort) {
+                    case Report_Sort_Duration: {
+                        usize end = table->is_open[entry] ? now_epoch : table->ends[entry];
+                        key = end > table->begins[entry] ? end - table->begins[entry] : 0;
+                    } break;
+                    case Report_Sort_Task: {
+                        // NOTE(dgl): flipping the sign bit keeps the order of the signed ids
+                        key = cast(uint32, table->task_ids[entry]) ^ 0x80000000;
+                    } break;
+                    case Report_Sort_Tag: {
+                        key = table->tag_counts[entry] > 0 ? tag_ranks[table->tag_ids[table->tag_offsets[entry]]] : table->tags.count;
+                    } break;
+                    default: {
+                        // NOTE(dgl): already sorted by begin
+                    }
+                }
+                result[index].sort_key = key;
+            }
+
+            sort_by_key(tmp_arena.arena, result, entry_count, thread_count);
+        }
+        mem_arena_end_temp(tmp_arena);
+    }
+
+    return result;
+}
+
+//
+// Group by
+// NOTE(dgl): sums the entries of a table per group in one pass. The groups are found with an
+// open addressing hash table (linear probing, at most half full) over the key of the group: the
+// interned id of a tag or the task id. An entry with several tags of the kind is part of each of
+// their groups, an entry without one is part of the group none.
+//
+
+typedef struct {
+    uint64  key;
+    uint32  count;
+    usize   seconds;
+    usize   first; // NOTE(dgl): begin of the first entry
+    int32   first_offset;
+    usize   last; // NOTE(dgl): end of the last entry
+    int32   last_offset;
+} Report_Group;
+
+typedef struct {
+    Report_Group *groups;
+    uint32        count;
+    uint32        cap;
+    uint32        slot_count; // NOTE(dgl): power of two
+    uint32       *slots; // NOTE(dgl): group index + 1, 0 is empty
+} Report_Groups;
+
+internal inline uint32
+report_group_slot(Report_Groups *groups, uint64 key) {
+    uint32 mask = groups->slot_count - 1;
+    uint32 result = cast(uint32, (key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while (groups->slots[result] != 0 && groups->groups[groups->slots[result] - 1].key != key) {
+        result = (result + 1) & mask;
+    }
+
+    return result;
+}
+
+internal Report_Group *
+report_group_get(Mem_Arena *arena, Report_Groups *groups, uint64 key) {
+    if (groups->count * 2 >= groups->slot_count) {
+        uint32 slot_count = max(groups->slot_count * 2, 64);
+        groups->slots = mem_arena_push_array(arena, uint32, slot_count);
+        memset(groups->slots, 0, slot_count * sizeof(uint32));
+        groups->slot_count = slot_count;
+        for (uint32 index = 0; index < groups->count; ++index) {
+            groups->slots[report_group_slot(groups, groups->groups[index].key)] = index + 1;
+        }
+    }
+
+    uint32 slot = report_group_slot(groups, key);
+    if (groups->slots[slot] == 0) {
+        if (groups->count == groups->cap) {
+            uint32 cap = max(groups->cap * 2, 32);
+            if (groups->cap == 0) {
+                groups->groups = mem_arena_push_array(arena, Report_Group, cap);
+            } else {
+                groups->groups = mem_arena_resize_array(arena, Report_Group, groups->groups, groups->cap, cap);
+            }
+            groups->cap = cap;
+        }
+
+        Report_Group *group = groups->groups + groups->count;
+        *group = (Report_Group){};
+        group->key = key;
+        group->first = cast(usize, -1);
+        groups->slots[slot] = ++groups->count;
+    }
+
+    Report_Group *result = groups->groups + groups->slots[slot] - 1;
+    return result;
+}
+
+internal inline void
+report_group_add(Report_Group *group, usize begin, int32 begin_offset, usize end, int32 end_offset) {
+    ++group->count;
+    group->seconds += end - begin;
+    if (begin < group->first) {
+        group->first = begin;
+        group->first_offset = begin_offset;
+    }
+    if (end >= group->last) {
+        group->last = end;
+        group->last_offset = end_offset;
+    }
+}
+
+// NOTE(dgl): prints one line per group, the groups with the most hours first
+internal void
+report_print_groups(Mem_Arena *temp_arena, Commandline *ctx, Entry_Table *table, Tag_Filter *filter) {
+    Report_Group_By group_by = ctx->report.group_by;
+    uint64 none_key = cast(uint64, -1);
+    char kind = group_by == Report_Group_Context ? '@' : '+';
+    usize now = datetime_to_epoch(&ctx->now);
+    int32 now_offset = datetime_offset_seconds(&ctx->now);
+
+    Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+    {
+        Report_Groups groups = {};
+        usize total_seconds = 0;
+        for (usize entry = 0; entry < table->count; ++entry) {
+            if (entry_table_tags_match(table, filter, entry)) {
+                usize begin = table->begins[entry];
+                usize end = table->is_open[entry] ? now : table->ends[entry];
+                int32 end_offset = table->is_open[entry] ? now_offset : table->end_offsets[entry];
+                assert(begin <= end, "End time cannot be larger than begin time");
+                total_seconds += end - begin;
+
+                if (group_by == Report_Group_Task) {
+                    Report_Group *group = report_group_get(tmp_arena.arena, &groups, cast(uint32, table->task_ids[entry]));
+                    report_group_add(group, begin, table->begin_offsets[entry], end, end_offset);
+                } else {
+                    bool32 has_group = false;
+                    uint32 *ids = table->tag_ids + table->tag_offsets[entry];
+                    for (uint32 index = 0; index < table->tag_counts[entry]; ++index) {
+                        if (table->tags.tags[ids[index]].text[0] == kind) {
+                            Report_Group *group = report_group_get(tmp_arena.arena, &groups, ids[index]);
+                            report_group_add(group, begin, table->begin_offsets[entry], end, end_offset);
+                            has_group = true;
+                        }
+                    }
+                    if (!has_group) {
+                        Report_Group *group = report_group_get(tmp_arena.arena, &groups, none_key);
+                        report_group_add(group, begin, table->begin_offsets[entry], end, end_offset);
+                    }
+                }
+            }
+        }
+
+        if (groups.count > 0) {
+            // NOTE(dgl): sorted by name first, groups with the same hours keep this order
+            uint32 *tag_ranks = group_by != Report_Group_Task ? tag_dictionary_ranks(tmp_arena.arena, &table->tags) : 0;
+            Sort_Entry *sort_entries = mem_arena_push_array(tmp_arena.arena, Sort_Entry, groups.count);
+            usize max_seconds = 0;
+            for (uint32 index = 0; index < groups.count; ++index) {
+                Report_Group *group = groups.groups + index;
+                uint64 key = group->key;
+                if (key == none_key) {
+                    key = cast(uint64, -1);
+                } else if (group_by == Report_Group_Task) {
+                    key = cast(uint32, key) ^ 0x80000000;
+                } else {
+                    key = tag_ranks[key];
+                }
+                sort_entries[index].sort_key = key;
+                sort_entries[index].index = cast(int32, index);
+                max_seconds = max(max_seconds, group->seconds);
+            }
+            sort_by_key(tmp_arena.arena, sort_entries, groups.count, 1);
+            for (uint32 index = 0; index < groups.count; ++index) {
+                sort_entries[index].sort_key = max_seconds - groups.groups[sort_entries[index].index].seconds;
+            }
+            sort_by_key(tmp_arena.arena, sort_entries, groups.count, 1);
+
+            char heading[128];
+            stbsp_snprintf(heading, sizeof(heading), "%-24s %8s %13s  %s\n", "group", "entries", "hours", "first - last");
+            print_datetime(tmp_arena.arena, 0, "%ts", string_from_c_str(heading));
+            for (uint32 index = 0; index < groups.count; ++index) {
+                Report_Group *group = groups.groups + sort_entries[index].index;
+                char name[64];
+                if (group->key == none_key) {
+                    stbsp_snprintf(name, sizeof(name), "(none)");
+                } else if (group_by == Report_Group_Task) {
+                    int32 task_id = cast(int32, cast(uint32, group->key));
+                    stbsp_snprintf(name, sizeof(name), task_id < 0 ? "(no task)" : "task %d", task_id);
+                } else {
+                    String tag = table->tags.tags[group->key];
+                    stbsp_snprintf(name, sizeof(name), "%.*s", cast(int32, tag.length), tag.text);
+                }
+
+                char columns[128];
+                stbsp_snprintf(columns, sizeof(columns), "%-24s %8u %7zu:%02zu hs  ", name, group->count, group->seconds / 3600, (group->seconds / 60) % 60);
+
+                Datetime first = epoch_to_datetime(group->first, group->first_offset);
+                Datetime last = epoch_to_datetime(group->last, group->last_offset);
+                print_datetime(tmp_arena.arena, 0, "%ts%td %tt - %td %tt\n", string_from_c_str(columns), first, first, last, last);
+            }
+            print_datetime(tmp_arena.arena, 0, "\nTotal hours: %th hs\n", total_seconds);
+        } else {
+            LOG("No entry found.");
+        }
+    }
+    mem_arena_end_temp(tmp_arena);
+}
+
+#if DEBUG
+internal inline uint64
+bench_random(uint64 *state) {
+    // NOTE(dgl): xorshift64*
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    uint64 result = *state * 0x2545F4914F6CDD1DULL;
+    return result;
+}
+
+typedef enum {
+    Bench_Sorted,
+    Bench_Swapped, // NOTE(dgl): sorted with parameter random swaps of neighbours (up to 64 apart)
+    Bench_Random, // NOTE(dgl): random keys with parameter bits
+} Bench_Pattern;
+
+internal void
+bench_fill(Sort_Entry *entries, uint32 entry_count, Bench_Pattern pattern, uint32 parameter, uint64 *random) {
+    for (uint32 index = 0; index < entry_count; ++index) {
+        entries[index].index = cast(int32, index);
+        if (pattern == Bench_Random) {
+            uint64 value = bench_random(random);
+            entries[index].sort_key = parameter < 64 ? value & ((0x1ULL << parameter) - 1) : value;
+        } else {
+            // NOTE(dgl): entries a few minutes apart, like a time file
+            entries[index].sort_key = index * 600;
+        }
+    }
+
+    if (pattern == Bench_Swapped && entry_count > 64) {
+        for (uint32 swap = 0; swap < parameter; ++swap) {
+            uint32 a = cast(uint32, bench_random(random) % (entry_count - 64));
+            uint32 b = a + 1 + cast(uint32, bench_random(random) % 63);
+            Sort_Entry temp = entries[a];
+            entries[a] = entries[b];
+            entries[b] = temp;
+        }
+    }
+}
+
+// NOTE(dgl): compares the fixed sort (eight 8 bit passes over the whole key) with the adaptive sort for different
+// inputs to find the thresholds. Times are the best of a few runs in cycles per entry.
+internal void
+sort_bench(Mem_Arena *temp_arena) {
+    uint32 entry_counts[] = {1000, 100000, 2000000};
+    struct {
+        char          *name;
+        Bench_Pattern  pattern;
+        uint32         parameter;
+    } cases[] = {
+        {"sorted",          Bench_Sorted,  0},
+        {"swapped n/1000",  Bench_Swapped, 1000},
+        {"swapped n/100",   Bench_Swapped, 100},
+        {"swapped n/32",    Bench_Swapped, 32},
+        {"swapped n/16",    Bench_Swapped, 16},
+        {"swapped n/8",     Bench_Swapped, 8},
+        {"swapped n/4",     Bench_Swapped, 4},
+        {"swapped n/2",     Bench_Swapped, 2},
+        {"random 11 bits",  Bench_Random,  11},
+        {"random 16 bits",  Bench_Random,  16},
+        {"random 22 bits",  Bench_Random,  22},
+        {"random 27 bits",  Bench_Random,  27},
+        {"random 32 bits",  Bench_Random,  32},
+        {"random 48 bits",  Bench_Random,  48},
+        {"random 64 bits",  Bench_Random,  64},
+    };
+
+    PRINT_DEBUG("%-16s %10s %12s %12s %8s\n", "input", "entries", "fixed c/e", "adaptive c/e", "speedup");
+    for (uint32 count_index = 0; count_index < array_count(entry_counts); ++count_index) {
+        uint32 entry_count = entry_counts[count_index];
+        for (uint32 case_index = 0; case_index < array_count(cases); ++case_index) {
+            Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+            {
+                Sort_Entry *input = mem_arena_push_array(tmp_arena.arena, Sort_Entry, entry_count);
+                Sort_Entry *entries = mem_arena_push_array(tmp_arena.arena, Sort_Entry, entry_count);
+                Sort_Entry *temp = mem_arena_push_array(tmp_arena.arena, Sort_Entry, entry_count);
+
+                uint64 random = 0x9E3779B97F4A7C15ULL;
+                uint32 parameter = cases[case_index].parameter;
+                if (cases[case_index].pattern == Bench_Swapped) {
+                    parameter = entry_count / parameter;
+                }
+                bench_fill(input, entry_count, cases[case_index].pattern, parameter, &random);
+
+                usize best_fixed = cast(usize, -1);
+                usize best_adaptive = cast(usize, -1);
+                for (int32 run = 0; run < 5; ++run) {
+                    memcpy(entries, input, entry_count * sizeof(Sort_Entry));
+                    usize begin = get_rdtsc();
+                    sort_radix(entries, temp, entry_count, 0, 8, 8);
+                    best_fixed = min(best_fixed, get_rdtsc() - begin);
+
+                    memcpy(entries, input, entry_count * sizeof(Sort_Entry));
+                    begin = get_rdtsc();
+                    sort_adaptive(tmp_arena.arena, entries, entry_count, 1);
+                    best_adaptive = min(best_adaptive, get_rdtsc() - begin);
+                }
+
+                PRINT_DEBUG("%-16s %10u %12.2f %12.2f %7.1fx\n", cases[case_index].name, entry_count,
+                            cast(real64, best_fixed) / entry_count, cast(real64, best_adaptive) / entry_count,
+                            cast(real64, best_fixed) / cast(real64, max(best_adaptive, 1)));
+            }
+            mem_arena_end_temp(tmp_arena);
+        }
+    }
+
+    // NOTE(dgl): scaling of the parallel radix sort with random 32 bit keys. The times are wall
+    // clock, the speedup is relative to the single threaded sort.
+    uint32 parallel_counts[] = {SORT_PARALLEL_MIN_COUNT, 2000000, 16000000};
+    uint32 thread_counts[] = {1, 2, 4, 8, 16};
+    PRINT_DEBUG("\n%10s %8s %10s %8s\n", "entries", "threads", "ms", "speedup");
+    for (uint32 count_index = 0; count_index < array_count(parallel_counts); ++count_index) {
+        uint32 entry_count = parallel_counts[count_index];
+        Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+        {
+            Sort_Entry *input = mem_arena_push_array(tmp_arena.arena, Sort_Entry, entry_count);
+            Sort_Entry *entries = mem_arena_push_array(tmp_arena.arena, Sort_Entry, entry_count);
+            Sort_Entry *temp = mem_arena_push_array(tmp_arena.arena, Sort_Entry, entry_count);
+
+            uint64 random = 0x9E3779B97F4A7C15ULL;
+            bench_fill(input, entry_count, Bench_Random, 32, &random);
+            uint32 digit_bits = 0;
+            uint32 pass_count = 0;
+            sort_radix_passes(32, &digit_bits, &pass_count);
+
+            real64 single_ms = 0;
+            for (uint32 thread_index = 0; thread_index < array_count(thread_counts); ++thread_index) {
+                uint32 thread_count = thread_counts[thread_index];
+                real64 best_ms = 1e30;
+                for (int32 run = 0; run < 5; ++run) {
+                    memcpy(entries, input, entry_count * sizeof(Sort_Entry));
+                    struct timespec begin = get_wall_clock();
+                    if (thread_count > 1) {
+                        sort_radix_parallel(tmp_arena.arena, entries, temp, entry_count, 0, digit_bits, pass_count, thread_count);
+                    } else {
+                        sort_radix(entries, temp, entry_count, 0, digit_bits, pass_count);
+                    }
+                    best_ms = min(best_ms, get_ms_elapsed(begin, get_wall_clock()));
+                }
+
+                if (thread_count == 1) {
+                    single_ms = best_ms;
+                }
+                PRINT_DEBUG("%10u %8u %10.2f %7.1fx\n", entry_count, thread_count, best_ms, single_ms / best_ms);
+            }
+        }
+        mem_arena_end_temp(tmp_arena);
+    }
+}
 #endif
+
+//
+// Binary
+// NOTE(dgl): time files ending with .ttb store the entries as fixed size records. The
+// annotations are stored once in a pool after the records, records reference them with offset
+// and length. Comments of text files are not kept.
+//
+// header | record 0 | ... | record count - 1 | (free records up to capacity) | annotation pool
+//
+// The free records let us append without moving the pool. If the capacity is reached we copy
+// the file with a larger capacity.
+//
+
+typedef enum {
+    Binary_Ordered = 0x1 << 0, // NOTE(dgl): the records are sorted by begin
+} Binary_Flags;
+
+typedef enum {
+    Binary_Record_Open = 0x1 << 0,
+} Binary_Record_Flags;
+
+typedef struct {
+    uint32  magic;
+    uint32  version;
+    uint64  record_count;
+    uint64  record_capacity;
+    uint64  pool_offset; // NOTE(dgl): file offset of the annotation pool (after record_capacity records)
+    uint64  pool_size;
+    uint32  flags;
+} Binary_Header;
+
+typedef struct {
+    uint64  begin; // NOTE(dgl): epoch
+    uint64  end; // NOTE(dgl): epoch, 0 if the entry is open
+    int32   begin_offset; // NOTE(dgl): timezone offset in seconds
+    int32   end_offset;
+    int32   task_id;
+    uint32  flags;
+    uint32  annotation_offset; // NOTE(dgl): offset into the pool
+    uint32  annotation_length;
+} Binary_Record;
+
+typedef struct {
+    Binary_Header   header;
+    Binary_Record  *records;
+    char           *pool;
+} Binary_Log;
+
+internal bool32
+file_is_binary(File_Stats *file) {
+    bool32 result = file->filename.length >= 4 &&
+                    string_compare(file->filename.text + file->filename.length - 4, ".ttb", 4) == 0;
+    return result;
+}
+
+// NOTE(dgl): free records for count records
+internal inline usize
+binary_capacity(usize count) {
+    usize result = count + max(count / 8, BINARY_MIN_CAPACITY);
+    return result;
+}
+
+internal inline usize
+binary_pool_offset(usize record_capacity) {
+    usize result = sizeof(Binary_Header) + record_capacity * sizeof(Binary_Record);
+    return result;
+}
+
+// NOTE(dgl): the log points into the buffer. An empty buffer is an empty log.
+internal bool32
+binary_from_buffer(Buffer *buffer, Binary_Log *log) {
+    *log = (Binary_Log){};
+
+    bool32 result = buffer->data_count == 0;
+    if (buffer->data_count >= sizeof(Binary_Header)) {
+        memcpy(&log->header, buffer->data, sizeof(Binary_Header));
+        Binary_Header *header = &log->header;
+        result = header->magic == BINARY_MAGIC &&
+                 header->version == BINARY_VERSION &&
+                 header->record_count <= header->record_capacity &&
+                 header->pool_offset == binary_pool_offset(header->record_capacity) &&
+                 header->pool_offset + header->pool_size <= buffer->data_count;
+        if (result) {
+            log->records = cast(Binary_Record *, cast(uint8 *, buffer->data) + sizeof(Binary_Header));
+            log->pool = cast(char *, buffer->data) + header->pool_offset;
+        }
+    }
+
+    return result;
+}
+
+// NOTE(dgl): the annotation of the entry points into the pool of the log
+internal Entry
+binary_entry(Binary_Log *log, usize index) {
+    Binary_Record *record = log->records + index;
+
+    Entry result = {};
+    result.begin = epoch_to_datetime(record->begin, record->begin_offset);
+    if (!(record->flags & Binary_Record_Open)) {
+        result.end = epoch_to_datetime(record->end, record->end_offset);
+    }
+    result.task_id = record->task_id;
+    result.annotation.text = log->pool + record->annotation_offset;
+    result.annotation.length = record->annotation_length;
+    result.annotation.cap = record->annotation_length;
+
+    return result;
+}
+
+internal Binary_Record
+binary_record_from_entry(Entry *entry, usize annotation_offset) {
+    Binary_Record result = {};
+    result.begin = datetime_to_epoch(&entry->begin);
+    result.begin_offset = datetime_offset_seconds(&entry->begin);
+    if (entry->end.year > 0) {
+        result.end = datetime_to_epoch(&entry->end);
+        result.end_offset = datetime_offset_seconds(&entry->end);
+    } else {
+        result.flags |= Binary_Record_Open;
+    }
+    result.task_id = entry->task_id;
+    result.annotation_offset = cast(uint32, annotation_offset);
+    result.annotation_length = cast(uint32, entry->annotation.length);
+
+    return result;
+}
+
+// NOTE(dgl): writes a new file with all entries. Equal annotations are stored once, we find
+// them with an open addressing hash table of the records which added an annotation to the pool.
+internal void
+binary_write(Mem_Arena *temp_arena, File_Stats *file, Entry *entries, usize count) {
+    Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+    {
+        usize capacity = binary_capacity(count);
+        usize slot_count = 1;
+        while (slot_count < count * 2) {
+            slot_count <<= 1;
+        }
+
+        usize pool_cap = 1;
+        for (usize index = 0; index < count; ++index) {
+            pool_cap += entries[index].annotation.length;
+        }
+
+        Binary_Record *records = mem_arena_push_array(tmp_arena.arena, Binary_Record, capacity);
+        memset(records, 0, capacity * sizeof(Binary_Record));
+        uint32 *slots = mem_arena_push_array(tmp_arena.arena, uint32, slot_count); // NOTE(dgl): record index + 1
+        memset(slots, 0, slot_count * sizeof(uint32));
+        char *pool = mem_arena_push_array(tmp_arena.arena, char, pool_cap);
+        usize pool_size = 0;
+
+        for (usize index = 0; index < count; ++index) {
+            String annotation = entries[index].annotation;
+            usize annotation_offset = 0;
+            if (annotation.length > 0) {
+                Hash_State state = hash_init();
+                hash_update(&state, annotation.text, annotation.length);
+                usize slot = hash_finish(&state) & (slot_count - 1);
+
+                for (;;) {
+                    if (slots[slot] == 0) {
+                        annotation_offset = pool_size;
+                        memcpy(pool + pool_size, annotation.text, annotation.length);
+                        pool_size += annotation.length;
+                        slots[slot] = cast(uint32, index + 1);
+                        break;
+                    }
+
+                    Binary_Record *other = records + slots[slot] - 1;
+                    if (other->annotation_length == annotation.length &&
+                        memcmp(pool + other->annotation_offset, annotation.text, annotation.length) == 0) {
+                        annotation_offset = other->annotation_offset;
+                        break;
+                    }
+                    slot = (slot + 1) & (slot_count - 1);
+                }
+            }
+            records[index] = binary_record_from_entry(entries + index, annotation_offset);
+        }
+
+        Binary_Header header = {};
+        header.magic = BINARY_MAGIC;
+        header.version = BINARY_VERSION;
+        header.flags = Binary_Ordered;
+        for (usize index = 1; index < count; ++index) {
+            if (records[index].begin < records[index - 1].begin) {
+                header.flags &= ~cast(uint32, Binary_Ordered);
+                break;
+            }
+        }
+        header.record_count = count;
+        header.record_capacity = capacity;
+        header.pool_offset = binary_pool_offset(capacity);
+        header.pool_size = pool_size;
+
+        Buffer buffers[3] = {};
+        buffers[0].data = &header;
+        buffers[0].data_count = sizeof(header);
+        buffers[1].data = records;
+        buffers[1].data_count = capacity * sizeof(Binary_Record);
+        buffers[2].data = pool;
+        buffers[2].data_count = pool_size;
+        rewrite_file(tmp_arena.arena, file, 0, buffers, array_count(buffers));
+        LOG_DEBUG("Wrote %lu records with %lu bytes of annotations", count, pool_size);
+    }
+    mem_arena_end_temp(tmp_arena);
+}
+
+// NOTE(dgl): copies the file with room for at least record_count records
+internal bool32
+binary_grow(Mem_Arena *temp_arena, File_Stats *file, usize record_count) {
+    bool32 result = false;
+
+    Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+    {
+        Buffer buffer = {};
+        File_Generation generation = {};
+        bool32 is_mapped = map_entire_file(tmp_arena.arena, file, &buffer, 0, &generation);
+
+        Binary_Log log = {};
+        if (binary_from_buffer(&buffer, &log)) {
+            usize count = log.header.record_count;
+            usize capacity = binary_capacity(max(log.header.record_capacity, record_count));
+
+            Binary_Header header = log.header;
+            header.magic = BINARY_MAGIC;
+            header.version = BINARY_VERSION;
+            header.record_capacity = capacity;
+            header.pool_offset = binary_pool_offset(capacity);
+            if (count == 0) {
+                header.flags = Binary_Ordered;
+            }
+
+            Buffer buffers[4] = {};
+            buffers[0].data = &header;
+            buffers[0].data_count = sizeof(header);
+            buffers[1].data = log.records;
+            buffers[1].data_count = count * sizeof(Binary_Record);
+            buffers[2].data_count = (capacity - count) * sizeof(Binary_Record);
+            buffers[2].data = mem_arena_push_array(tmp_arena.arena, uint8, buffers[2].data_count);
+            memset(buffers[2].data, 0, buffers[2].data_count);
+            buffers[3].data = log.pool;
+            buffers[3].data_count = header.pool_size;
+            rewrite_file(tmp_arena.arena, file, 0, buffers, array_count(buffers));
+            LOG_DEBUG("Increased the record capacity to %lu", capacity);
+            result = true;
+        } else {
+            LOG("Invalid binary time file %s", string_to_c_str(tmp_arena.arena, file->filename));
+        }
+
+        if (is_mapped) {
+            unmap_file(&buffer);
+        }
+    }
+    mem_arena_end_temp(tmp_arena);
+
+    return result;
+}
+
+// NOTE(dgl): writes the entries as the records first to first + count - 1 (the file has
+// first records or more). The writer lock must be held. We do not search the pool, its size
+// grows with the history. continue repeats the annotation of the record before and stop
+// rewrites a record with its own annotation, these are reused. Other annotations are appended
+// to the pool, binary_write removes the duplicates if the file is converted.
+internal void
+binary_update(Mem_Arena *temp_arena, File_Stats *file, Entry *entries, usize first, usize count) {
+    Binary_Header header = {};
+    int fd = open(file->filename.text, O_RDONLY);
+    if (fd >= 0) {
+        ssize_t res = pread(fd, &header, sizeof(header), 0);
+        close(fd);
+        if (res == 0 || header.record_capacity < first + count) {
+            // NOTE(dgl): an empty file gets the header with the grow as well
+            if (!binary_grow(temp_arena, file, first + count)) {
+                return;
+            }
+        }
+    }
+
+    Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+    {
+        Buffer buffer = {};
+        File_Generation generation = {};
+        bool32 is_mapped = map_entire_file(tmp_arena.arena, file, &buffer, 0, &generation);
+
+        Binary_Log log = {};
+        fd = open(file->filename.text, O_WRONLY);
+        if (!is_mapped || fd < 0 || !binary_from_buffer(&buffer, &log)) {
+            LOG("Failed to update the binary time file %s", string_to_c_str(tmp_arena.arena, file->filename));
+        } else {
+            header = log.header;
+
+            usize pending_cap = 1;
+            for (usize index = 0; index < count; ++index) {
+                pending_cap += entries[index].annotation.length;
+            }
+            char *pending = mem_arena_push_array(tmp_arena.arena, char, pending_cap);
+            usize pending_size = 0;
+            Binary_Record *records = mem_arena_push_array(tmp_arena.arena, Binary_Record, count);
+
+            for (usize index = 0; index < count; ++index) {
+                String annotation = entries[index].annotation;
+                usize annotation_offset = 0;
+                usize record_index = first + index;
+                Binary_Record *same = record_index < header.record_count ? log.records + record_index : 0;
+                Binary_Record *before = record_index > 0 && record_index - 1 < header.record_count ? log.records + record_index - 1 : 0;
+                if (index > 0 && annotation.text == entries[index - 1].annotation.text &&
+                    annotation.length == entries[index - 1].annotation.length) {
+                    annotation_offset = records[index - 1].annotation_offset;
+                } else if (same && same->annotation_length == annotation.length &&
+                           memcmp(log.pool + same->annotation_offset, annotation.text, annotation.length) == 0) {
+                    annotation_offset = same->annotation_offset;
+                } else if (before && before->annotation_length == annotation.length &&
+                           memcmp(log.pool + before->annotation_offset, annotation.text, annotation.length) == 0) {
+                    annotation_offset = before->annotation_offset;
+                } else if (annotation.length > 0) {
+                    char *found = memmem(pending, pending_size, annotation.text, annotation.length);
+                    if (!found) {
+                        found = pending + pending_size;
+                        memcpy(found, annotation.text, annotation.length);
+                        pending_size += annotation.length;
+                    }
+                    annotation_offset = header.pool_size + cast(usize, found - pending);
+                }
+                records[index] = binary_record_from_entry(entries + index, annotation_offset);
+            }
+
+            // NOTE(dgl): the flag is only cleared here, binary_write checks the order again
+            uint64 previous_begin = first > 0 && first - 1 < header.record_count ? log.records[first - 1].begin : 0;
+            for (usize index = 0; index < count; ++index) {
+                if (records[index].begin < previous_begin) {
+                    header.flags &= ~cast(uint32, Binary_Ordered);
+                }
+                previous_begin = records[index].begin;
+            }
+            if (first + count < header.record_count && log.records[first + count].begin < previous_begin) {
+                header.flags &= ~cast(uint32, Binary_Ordered);
+            }
+
+            off_t pool_end = cast(off_t, header.pool_offset + header.pool_size);
+            off_t record_offset = cast(off_t, sizeof(Binary_Header) + first * sizeof(Binary_Record));
+            usize record_size = count * sizeof(Binary_Record);
+            header.record_count = max(header.record_count, first + count);
+            header.pool_size += pending_size;
+
+            if (pwrite(fd, pending, pending_size, pool_end) != cast(ssize_t, pending_size) ||
+                pwrite(fd, records, record_size, record_offset) != cast(ssize_t, record_size) ||
+                pwrite(fd, &header, sizeof(header), 0) != cast(ssize_t, sizeof(header))) {
+                LOG("Failed writing to file %s with error: %d", string_to_c_str(tmp_arena.arena, file->filename), errno);
+            }
+        }
+
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (is_mapped) {
+            unmap_file(&buffer);
+        }
+    }
+    mem_arena_end_temp(tmp_arena);
+}
+
+// NOTE(dgl): same as tail_read_last_entry for binary files. Only found and entry are set, the
+// annotation is copied into the arena. record_count is the number of records in the file.
+internal Tail_Entry
+binary_read_last_entry(Mem_Arena *arena, File_Stats *file, Tokenizer *tokenizer, usize *record_count) {
+    Tail_Entry result = {};
+    *record_count = 0;
+
+    Buffer buffer = {};
+    File_Generation generation = {};
+    bool32 is_mapped = map_entire_file(arena, file, &buffer, 0, &generation);
+
+    Binary_Log log = {};
+    if (binary_from_buffer(&buffer, &log)) {
+        *record_count = log.header.record_count;
+        if (log.header.record_count > 0) {
+            result.found = true;
+            result.entry = binary_entry(&log, log.header.record_count - 1);
+
+            String annotation = result.entry.annotation;
+            result.entry.annotation.text = mem_arena_push_array(arena, char, annotation.length + 1);
+            string_copy(annotation.text, annotation.length, result.entry.annotation.text, annotation.length);
+            result.entry.annotation.text[annotation.length] = 0;
+        }
+    } else {
+        tokenizer->has_error = true;
+        stbsp_snprintf(tokenizer->error_msg, sizeof(tokenizer->error_msg), "Invalid binary time file");
+    }
+
+    if (is_mapped) {
+        unmap_file(&buffer);
+    }
+
+    return result;
+}
+
+internal void
+binary_fill_table(Mem_Arena *arena, Binary_Log *log, usize from_sentinel, usize to_sentinel, Entry_Table *table) {
+    table->text = log->pool;
+    bool32 is_ordered = (log->header.flags & Binary_Ordered) != 0;
+
+    // NOTE(dgl): ordered records only have to be read from the first record in the range
+    usize first = 0;
+    usize last = log->header.record_count;
+    if (is_ordered) {
+        usize count = last;
+        while (count > 0) {
+            usize half = count / 2;
+            if (log->records[first + half].begin <= from_sentinel) {
+                first += half + 1;
+                count -= half + 1;
+            } else {
+                count = half;
+            }
+        }
+    }
+
+    for (usize index = first; index < last; ++index) {
+        Binary_Record *record = log->records + index;
+        if (is_ordered && record->begin >= to_sentinel) {
+            break;
+        }
+
+        if (record->begin > from_sentinel && record->begin < to_sentinel) {
+            if (table->count == table->cap) {
+                entry_table_grow(arena, table, max(table->cap * 2, 1024));
+            }
+
+            usize entry = table->count++;
+            table->begins[entry] = record->begin;
+            table->ends[entry] = record->end;
+            table->begin_offsets[entry] = record->begin_offset;
+            table->end_offsets[entry] = record->end_offset;
+            table->task_ids[entry] = record->task_id;
+            table->annotation_offsets[entry] = record->annotation_offset;
+            table->annotation_lengths[entry] = record->annotation_length;
+            table->is_open[entry] = (record->flags & Binary_Record_Open) != 0;
+            if (table->has_tags) {
+                entry_table_push_tags(arena, table, entry_table_annotation(table, entry));
+            }
+        }
+    }
+}
+
+//
+// Batch
+//
+
+// NOTE(dgl): the parsed time file. Entries which are not dirty still match their line in the
+// file, therefore we only have to write the entries from dirty_index on.
+typedef struct {
+    Entry   *entries;
+    usize   *offsets; // NOTE(dgl): file offset of the line of each loaded entry
+    usize   *begins;  // NOTE(dgl): epoch of begin of each entry
+    uint32  count;
+    uint32  cap;
+    uint32  loaded_count;
+    uint32  dirty_index;
+    usize   filesize;
+    bool32  ends_with_newline;
+    bool32  is_unordered; // NOTE(dgl): an entry was added with a begin before the last entry
+} Time_Log;
+
+internal void
+time_log_push(Mem_Arena *arena, Time_Log *log, Entry *entry, usize offset) {
+    if (log->cap == 0) {
+        log->cap = 1024;
+        log->entries = mem_arena_push_array(arena, Entry, log->cap);
+        log->offsets = mem_arena_push_array(arena, usize, log->cap);
+        log->begins = mem_arena_push_array(arena, usize, log->cap);
+    } else if (log->count == log->cap) {
+        usize current_cap = log->cap;
+        log->cap *= 2;
+        log->entries = mem_arena_resize_array(arena, Entry, log->entries, current_cap, log->cap);
+        log->offsets = mem_arena_resize_array(arena, usize, log->offsets, current_cap, log->cap);
+        log->begins = mem_arena_resize_array(arena, usize, log->begins, current_cap, log->cap);
+    }
+
+    log->entries[log->count] = *entry;
+    log->offsets[log->count] = offset;
+    log->begins[log->count] = datetime_to_epoch(&entry->begin);
+    log->count++;
+}
+
+// NOTE(dgl): the annotations point into the file buffer, which stays in the arena.
+internal bool32
+time_log_load(Mem_Arena *arena, Mem_Arena *temp_arena, File_Stats *file, Time_Log *log) {
+    *log = (Time_Log){};
+
+    struct stat file_stat = {};
+    if (stat(file->filename.text, &file_stat) == 0) {
+        file->filesize = cast(usize, file_stat.st_size);
+    }
+    Buffer buffer = allocate_filebuffer(arena, file);
+    read_entire_file(temp_arena, file, &buffer);
+    log->filesize = buffer.data_count;
+    log->ends_with_newline = buffer.data_count == 0 || (cast(char *, buffer.data))[buffer.data_count - 1] == '\n';
+
+    bool32 result = false;
+    if (file_is_binary(file)) {
+        Binary_Log binary = {};
+        result = binary_from_buffer(&buffer, &binary);
+        if (result) {
+            for (usize index = 0; index < binary.header.record_count; ++index) {
+                Entry entry = binary_entry(&binary, index);
+                time_log_push(arena, log, &entry, index);
+            }
+        } else {
+            LOG("Invalid binary time file %s", string_to_c_str(temp_arena, file->filename));
+        }
+    } else {
+        Tokenizer tokenizer = {};
+        fill_tokenizer(&tokenizer, &buffer);
+        eat_all_whitespace(&tokenizer);
+        while (!tokenizer.has_error && tokenizer.input.length > 0) {
+            usize offset = cast(usize, tokenizer.input.text - cast(char *, buffer.data));
+            Entry entry = parse_entry(&tokenizer);
+            if (!tokenizer.has_error) {
+                time_log_push(arena, log, &entry, offset);
+            }
+            eat_all_whitespace(&tokenizer);
+        }
+
+        if (tokenizer.has_error) {
+            LOG("Tokenizer error: %s", tokenizer.error_msg);
+        }
+        result = !tokenizer.has_error;
+    }
+
+    log->loaded_count = log->count;
+    log->dirty_index = log->count;
+
+    return result;
+}
+
+// NOTE(dgl): writes all entries of the log into a new file in the format of the file
+internal void
+time_log_write(Mem_Arena *temp_arena, File_Stats *file, Time_Log *log) {
+    if (file_is_binary(file)) {
+        binary_write(temp_arena, file, log->entries, log->count);
+    } else {
+        Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+        {
+            String_Builder builder = string_builder_init(tmp_arena.arena, (log->count + 1) * AVERAGE_CHARS_PER_LINE);
+            for (uint32 index = 0; index < log->count; ++index) {
+                Buffer line = entry_to_buffer(tmp_arena.arena, log->entries + index);
+                string_append(&builder, "%.*s", cast(int32, line.data_count), cast(char *, line.data));
+            }
+
+            String string = string_builder_to_string(&builder);
+            Buffer buffer = string_to_buffer(&string);
+            write_entire_file(tmp_arena.arena, file, 1, &buffer);
+        }
+        mem_arena_end_temp(tmp_arena);
+    }
+}
+
+// NOTE(dgl): writes the dirty entries. If we only added entries we append them, otherwise
+// we keep the file up to the first changed entry and rewrite the rest. The offsets of the
+// written entries are updated, the server keeps the log and flushes it again.
+internal void
+time_log_flush(Mem_Arena *arena, File_Stats *file, Time_Log *log) {
+    if (log->dirty_index < log->count && file_is_binary(file)) {
+        binary_update(arena, file, log->entries + log->dirty_index, log->dirty_index, log->count - log->dirty_index);
+        for (uint32 index = log->dirty_index; index < log->count; ++index) {
+            log->offsets[index] = index;
+        }
+        log->loaded_count = log->count;
+        log->dirty_index = log->count;
+    } else if (log->dirty_index < log->count) {
+        Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(arena);
+        {
+            String_Builder builder = string_builder_init(tmp_arena.arena, (log->count - log->dirty_index) * AVERAGE_CHARS_PER_LINE);
+            bool32 is_append = log->dirty_index >= log->loaded_count;
+            usize keep_size = is_append ? log->filesize : log->offsets[log->dirty_index];
+            usize offset = keep_size;
+            if (is_append && !log->ends_with_newline) {
+                string_append(&builder, "\n");
+                offset += 1;
+            }
+
+            for (uint32 index = log->dirty_index; index < log->count; ++index) {
+                Buffer line = entry_to_buffer(tmp_arena.arena, log->entries + index);
+                string_append(&builder, "%.*s", cast(int32, line.data_count), cast(char *, line.data));
+                log->offsets[index] = offset;
+                offset += line.data_count;
+            }
+
+            String string = string_builder_to_string(&builder);
+            Buffer buffer = string_to_buffer(&string);
+            if (is_append) {
+                append_to_file(tmp_arena.arena, file, 1, &buffer);
+            } else {
+                rewrite_file(tmp_arena.arena, file, keep_size, &buffer, 1);
+            }
+            log->filesize = offset;
+            log->ends_with_newline = true;
+        }
+        mem_arena_end_temp(tmp_arena);
+
+        if (log->is_unordered) {
+            index_clear_ordered(file);
+            log->is_unordered = false;
+        }
+
+        log->loaded_count = log->count;
+        log->dirty_index = log->count;
+    }
+}
+
+// NOTE(dgl): runs start/stop/continue/report on the log. The command line needs to be parsed
+// with the command arguments before.
+internal void
+time_log_run_command(Commandline *ctx, Time_Log *log, Mem_Arena *arena, Mem_Arena *temp_arena) {
+    Entry *last = log->count > 0 ? log->entries + log->count - 1 : 0;
+
+    switch (ctx->command_type) {
+        case Command_Type_Start:
+        case Command_Type_Continue: {
+            if (last && last->end.year == 0) {
+                LOG("Time interval currently active with annotation: %s", string_to_c_str(temp_arena, last->annotation));
+            } else if (ctx->command_type == Command_Type_Continue && !last) {
+                LOG("No time interval to continue");
+            } else {
+                Entry entry = {};
+                entry.begin = ctx->now;
+                if (ctx->command_type == Command_Type_Continue) {
+                    entry.task_id = last->task_id;
+                    entry.annotation = last->annotation;
+                } else {
+                    // NOTE(dgl): the command line can live in a shorter living arena than the log
+                    entry.task_id = ctx->start.task_id;
+                    entry.annotation.length = ctx->start.annotation.length;
+                    entry.annotation.cap = ctx->start.annotation.length;
+                    entry.annotation.text = mem_arena_push_array(arena, char, entry.annotation.length + 1);
+                    string_copy(ctx->start.annotation.text, ctx->start.annotation.length, entry.annotation.text, entry.annotation.length);
+                }
+                if (last && datetime_to_epoch(&entry.begin) < log->begins[log->count - 1]) {
+                    log->is_unordered = true;
+                }
+                // NOTE(dgl): time_log_flush sets the offset when it writes the entry
+                time_log_push(arena, log, &entry, 0);
+            }
+        } break;
+        case Command_Type_Stop: {
+            if (!last || last->end.year != 0) {
+                LOG("No time interval active");
+            } else {
+                last->end = ctx->now;
+                log->dirty_index = min(log->dirty_index, log->count - 1);
+            }
+        } break;
+        case Command_Type_Report: {
+            usize from_sentinel = datetime_to_epoch(&ctx->report.from);
+            usize to_sentinel = datetime_to_epoch(&ctx->report.to);
+
+            Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+            {
+                // NOTE(dgl): the table keeps a copy of the annotations of the matching entries
+                Entry_Table table = {};
+                table.has_tags = report_needs_tags(ctx);
+                for (uint32 index = 0; index < log->count; ++index) {
+                    Entry *entry = log->entries + index;
+                    usize begin = log->begins[index];
+                    if (begin > from_sentinel && begin < to_sentinel && report_tag_matches(ctx, entry->annotation)) {
+                        usize end = entry->end.year != 0 ? datetime_to_epoch(&entry->end) : 0;
+                        entry_table_push_copy(tmp_arena.arena, &table, entry, begin, end);
+                    }
+                }
+
+                uint32 entry_count = cast(uint32, table.count);
+                if (entry_count > 0 && ctx->report.group_by != Report_Group_None) {
+                    // NOTE(dgl): the entries are already filtered
+                    Tag_Filter filter = {};
+                    filter.filter = &(Report_Filter){};
+                    report_print_groups(tmp_arena.arena, ctx, &table, &filter);
+                } else if (entry_count > 0) {
+                    Sort_Entry *sort_entries = report_sort_table(tmp_arena.arena, tmp_arena.arena, &table, ctx->report.sort, from_sentinel, &ctx->now, ctx->thread_count);
+
+                    Report_Printer printer = {};
+                    printer.arena = tmp_arena.arena;
+                    printer.now = ctx->now;
+                    printer.print_flags = Print_Timezone;
+                    printer.is_flat = ctx->report.sort != Report_Sort_Begin;
+                    for (uint32 index = 0; index < entry_count; ++index) {
+                        usize entry_index = cast(usize, sort_entries[index].index);
+                        Datetime begin = epoch_to_datetime(table.begins[entry_index], table.begin_offsets[entry_index]);
+                        Datetime end = {};
+                        if (!table.is_open[entry_index]) {
+                            end = epoch_to_datetime(table.ends[entry_index], table.end_offsets[entry_index]);
+                        }
+                        report_print_entry(&printer, table.begins[entry_index], &begin, &end);
+                    }
+                    report_print_total(&printer);
+                } else {
+                    LOG("No entry found.");
+                }
             }
+            mem_arena_end_temp(tmp_arena);
+        } break;
+        default: {
+            LOG("Command %d is not supported in batch mode", ctx->command_type);
+        }
+    }
+}
+
+// NOTE(dgl): reads everything from the file descriptor into the arena (zero terminated).
+internal String
+read_entire_fd(Mem_Arena *arena, int fd) {
+    String result = {};
+    result.cap = kilobytes(4);
+    result.text = mem_arena_push_array(arena, char, result.cap + 1);
+
+    ssize_t res = 0;
+    do {
+        if (result.length == result.cap) {
+            usize current_cap = result.cap;
+            result.cap *= 2;
+            result.text = mem_arena_resize_array(arena, char, result.text, current_cap + 1, result.cap + 1);
+        }
+        res = read(fd, result.text + result.length, result.cap - result.length);
+        if (res > 0) {
+            result.length += cast(usize, res);
         }
+    } while (res > 0);
 
-        args += cursor;
-        args_count -= cursor;
-        cursor = 0;
+    result.text[result.length] = 0;
+    return result;
+}
+
+// NOTE(dgl): splits the line at whitespace in place. Returns the number of args.
+internal int32
+split_args(char *line, char **args, int32 max_args) {
+    int32 result = 0;
+    char *cursor = line;
+    while (*cursor && result < max_args) {
+        while (is_whitespace(*cursor)) {
+            *cursor++ = 0;
+        }
+        if (*cursor) {
+            args[result++] = cursor;
+            while (*cursor && !is_whitespace(*cursor)) {
+                ++cursor;
+            }
+        }
     }
 
-    if (ctx->is_valid) {
-        PRINT_DEBUG("Running ttime with these args:\n\tfilename=%s\n", string_to_c_str(ctx->arena, ctx->file.filename));
-        switch (ctx->command_type) {
-            case Command_Type_Start: {
-                commandline_parse_start_cmd(ctx, args, args_count);
-                PRINT_DEBUG("\tcommand=start\n\ttask_id=%d\n\tannotation=%s\n", ctx->start.task_id, string_to_c_str(ctx->arena, ctx->start.annotation));
-            } break;
-            case Command_Type_Continue: {
-                PRINT_DEBUG("\tcommand=continue\n");
-            } break;
-            case Command_Type_Stop: {
-                PRINT_DEBUG("\tcommand=stop\n");
-            } break;
-            case Command_Type_Report: {
-                commandline_parse_report_cmd(ctx, args, args_count);
-                PRINT_DEBUG("\tcommand=report\n");
-            } break;
-            case Command_Type_CSV: {
-                commandline_parse_csv_cmd(ctx, args, args_count);
-                PRINT_DEBUG("\tcommand=csv\n");
-            } break;
-#if DEBUG
-            case Command_Type_Test: {
-                commandline_parse_test_cmd(ctx, args, args_count);
-                PRINT_DEBUG("\tcommand=test\n");
-            } break;
-#endif
-            default:
-                // NOTE(dgl): something went wrong
-                ctx->is_valid = false;
+    return result;
+}
+
+internal void
+batch_run(Commandline *ctx, Mem_Arena *arena, Mem_Arena *temp_arena) {
+    int input_fd = STDIN_FILENO;
+    if (ctx->batch.input.length > 0) {
+        input_fd = open(ctx->batch.input.text, O_RDONLY);
+        if (input_fd < 0) {
+            LOG("Could not open file: %s", ctx->batch.input.text);
+            return;
         }
     }
+    String input = read_entire_fd(arena, input_fd);
+    if (input_fd != STDIN_FILENO) {
+        close(input_fd);
+    }
 
-    if (!ctx->file.exists) {
-        ctx->is_valid = false;
-        LOG("File %s does not exist. To create it automatically use the -f flag", string_to_c_str(ctx->arena, ctx->file.filename));
+    File_Lock lock = file_lock(temp_arena, &ctx->file);
+    if (lock.fd < 0) {
+        return;
+    }
+
+    Time_Log log = {};
+    if (time_log_load(arena, temp_arena, &ctx->file, &log)) {
+        uint32 command_count = 0;
+        char *line = input.text;
+        while (*line) {
+            char *line_end = line;
+            while (*line_end && *line_end != '\n') {
+                ++line_end;
+            }
+            char *next_line = *line_end ? line_end + 1 : line_end;
+            *line_end = 0;
+
+            char *args[64];
+            int32 args_count = split_args(line, args, array_count(args));
+            if (args_count > 0 && string_compare("//", args[0], 2) != 0) {
+                Commandline command = {};
+                command.arena = arena;
+                command.file = ctx->file;
+                command.is_valid = true;
+                command.now = ctx->now;
+
+                int32 cursor = 0;
+                if (args[0][0] >= '0' && args[0][0] <= '9') {
+                    Tokenizer tokenizer = {};
+                    tokenizer.input = string_from_c_str(args[0]);
+                    tokenizer.base = tokenizer.input.text;
+                    command.now = parse_datetime(&tokenizer);
+                    if (tokenizer.has_error) {
+                        LOG("Invalid timestamp in batch command %u: %s", command_count + 1, tokenizer.error_msg);
+                        command.is_valid = false;
+                    }
+                    ++cursor;
+                }
+
+                if (command.is_valid && cursor < args_count) {
+                    char *name = args[cursor++];
+                    if (string_compare("sta", name, 3) == 0) {
+                        command.command_type = Command_Type_Start;
+                        commandline_parse_start_cmd(&command, args + cursor, args_count - cursor);
+                    } else if (string_compare("con", name, 3) == 0) {
+                        command.command_type = Command_Type_Continue;
+                    } else if (string_compare("sto", name, 3) == 0) {
+                        command.command_type = Command_Type_Stop;
+                    } else if (string_compare("rep", name, 3) == 0) {
+                        command.command_type = Command_Type_Report;
+                        commandline_parse_report_cmd(&command, args + cursor, args_count - cursor);
+                    } else {
+                        LOG("Unknown batch command %u: %s", command_count + 1, name);
+                        command.is_valid = false;
+                    }
+
+                    if (command.is_valid) {
+                        time_log_run_command(&command, &log, arena, temp_arena);
+                    }
+                }
+                ++command_count;
+            }
+
+            line = next_line;
+        }
+
+        time_log_flush(temp_arena, &ctx->file, &log);
+        LOG_DEBUG("Executed %u batch commands", command_count);
     }
+
+    file_unlock(&lock);
 }
 
 //
-// Sorting
+// Server
+// NOTE(dgl): a request are the args of the client separated by zero bytes. The client closes
+// its write side after the request and the server answers with the output of the command.
 //
 
+global volatile sig_atomic_t serve_is_running;
+
 internal void
-sort_radix(Sort_Entry *first, Sort_Entry *temp, uint32 entry_count) {
-    Sort_Entry *source = first;
-    Sort_Entry *dest = temp;
-    for(uint32 byte_index = 0; byte_index < 32; byte_index += 8) {
-        uint32 sort_key_offset[256] = {};
+serve_handle_signal(int signal) {
+    (void)signal;
+    serve_is_running = false;
+}
 
-        // NOTE(casey): First pass - count how many of each key
-        for(uint32 index = 0; index < entry_count; ++index) {
-            usize radix_value = source[index].sort_key;
-            usize radix_piece = (radix_value >> byte_index) & 0xFF;
-            ++sort_key_offset[radix_piece];
+// NOTE(dgl): returns false if the path is too long for a unix socket
+internal bool32
+serve_socket_address(File_Stats *file, struct sockaddr_un *address) {
+    bool32 result = false;
+    *address = (struct sockaddr_un){};
+    address->sun_family = AF_UNIX;
+
+    usize suffix_length = string_length(".sock");
+    if (file->filename.length + suffix_length < sizeof(address->sun_path)) {
+        string_concat(file->filename.text, file->filename.length, ".sock", suffix_length, address->sun_path, sizeof(address->sun_path));
+        result = true;
+    }
+
+    return result;
+}
+
+// NOTE(dgl): sends the args to the server and prints the answer. Returns false if there is no
+// server for this file.
+internal bool32
+serve_client_request(File_Stats *file, char **args, int args_count) {
+    bool32 result = false;
+
+    struct sockaddr_un address;
+    if (serve_socket_address(file, &address) && access(address.sun_path, F_OK) == 0) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0) {
+            if (connect(fd, cast(struct sockaddr *, &address), sizeof(address)) == 0) {
+                // NOTE(dgl): the socket already belongs to the file, therefore we do not send -f
+                result = true;
+                for (int index = 1; index < args_count && result; ++index) {
+                    if (string_compare("-f", args[index], 2) == 0) {
+                        ++index;
+                        continue;
+                    }
+                    usize length = string_length(args[index]) + 1;
+                    result = write(fd, args[index], length) == cast(ssize_t, length);
+                }
+                shutdown(fd, SHUT_WR);
+
+                char answer[4096];
+                ssize_t res = 0;
+                while ((res = read(fd, answer, sizeof(answer))) > 0) {
+                    fwrite(answer, cast(usize, res), 1, stdout);
+                }
+                fflush(stdout);
+            } else {
+                LOG_DEBUG("No server running on %s", address.sun_path);
+            }
+            close(fd);
         }
+    }
 
-        // NOTE(casey): Change counts to offsets
-        uint32 total = 0;
-        for(uint32 sort_key_index = 0;
-            sort_key_index < array_count(sort_key_offset);
-            ++sort_key_index) {
-            uint32 count = sort_key_offset[sort_key_index];
-            sort_key_offset[sort_key_index] = total;
-            total += count;
+    return result;
+}
+
+internal File_Generation
+serve_current_generation(File_Stats *file) {
+    File_Generation result = {};
+    struct stat file_stat = {};
+    if (stat(file->filename.text, &file_stat) == 0) {
+        result = file_generation_from_stat(&file_stat);
+    }
+    return result;
+}
+
+// NOTE(dgl): log_arena must only contain the log, it is freed on reload
+internal void
+serve_reload_if_changed(Mem_Arena *log_arena, Mem_Arena *temp_arena, File_Stats *file, Time_Log *log, File_Generation *generation) {
+    if (file_generation_changed(file, generation)) {
+        LOG_DEBUG("Time file changed. Reloading");
+        mem_arena_free_all(log_arena);
+        *generation = serve_current_generation(file);
+        time_log_load(log_arena, temp_arena, file, log);
+    }
+}
+
+internal void
+serve_handle_request(Commandline *ctx, int client_fd, Time_Log *log, File_Generation *generation, Mem_Arena *log_arena, Mem_Arena *temp_arena) {
+    char *request = mem_arena_push_array(temp_arena, char, SERVE_REQUEST_SIZE + 1);
+    usize request_size = 0;
+    ssize_t res = 0;
+    while (request_size < SERVE_REQUEST_SIZE &&
+           (res = read(client_fd, request + request_size, SERVE_REQUEST_SIZE - request_size)) > 0) {
+        request_size += cast(usize, res);
+    }
+
+    if (res < 0) {
+        // NOTE(dgl): the client did not finish its request in time
+        LOG("Dropping request with error: %d", errno);
+        return;
+    }
+
+    char *args[64];
+    int args_count = 0;
+    args[args_count++] = "ttime";
+    args[args_count++] = "-f";
+    args[args_count++] = ctx->file.filename.text;
+    usize cursor = 0;
+    while (cursor < request_size && args_count < array_count(args)) {
+        args[args_count++] = request + cursor;
+        cursor += string_length(request + cursor) + 1;
+    }
+
+    Commandline command = {};
+    commandline_parse(temp_arena, &command, args, args_count);
+
+    // NOTE(dgl): everything the command prints goes to the client. LOG writes to stderr in
+    // debug builds.
+    fflush(stdout);
+    fflush(stderr);
+    int stdout_fd = dup(STDOUT_FILENO);
+    int stderr_fd = dup(STDERR_FILENO);
+    dup2(client_fd, STDOUT_FILENO);
+    dup2(client_fd, STDERR_FILENO);
+
+    if (command.is_valid) {
+        bool32 is_writer = command.command_type == Command_Type_Start ||
+                           command.command_type == Command_Type_Stop ||
+                           command.command_type == Command_Type_Continue;
+        if (is_writer) {
+            File_Lock lock = file_lock(temp_arena, &ctx->file);
+            if (lock.fd >= 0) {
+                serve_reload_if_changed(log_arena, temp_arena, &ctx->file, log, generation);
+                time_log_run_command(&command, log, log_arena, temp_arena);
+                time_log_flush(temp_arena, &ctx->file, log);
+                *generation = serve_current_generation(&ctx->file);
+                file_unlock(&lock);
+            }
+        } else if (command.command_type == Command_Type_Report) {
+            serve_reload_if_changed(log_arena, temp_arena, &ctx->file, log, generation);
+            time_log_run_command(&command, log, log_arena, temp_arena);
+        } else {
+            LOG("Command %d is not supported by the server", command.command_type);
         }
+    } else {
+        LOG("Invalid arguments");
+    }
 
-        // NOTE(casey): Second pass - place elements into the right location
-        for(uint32 index = 0; index < entry_count; ++index) {
-            usize radix_value = source[index].sort_key;
-            usize radix_piece = (radix_value >> byte_index) & 0xFF;
-            dest[sort_key_offset[radix_piece]++] = source[index];
+    fflush(stdout);
+    fflush(stderr);
+    dup2(stdout_fd, STDOUT_FILENO);
+    dup2(stderr_fd, STDERR_FILENO);
+    close(stdout_fd);
+    close(stderr_fd);
+}
+
+internal void
+serve_run(Commandline *ctx, Mem_Arena *temp_arena) {
+    struct sockaddr_un address;
+    if (!serve_socket_address(&ctx->file, &address)) {
+        LOG("Filename too long for the socket path");
+        return;
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        LOG("Failed to create socket with error: %d", errno);
+        return;
+    }
+
+    if (access(address.sun_path, F_OK) == 0) {
+        if (connect(listen_fd, cast(struct sockaddr *, &address), sizeof(address)) == 0) {
+            LOG("Server already running on %s", address.sun_path);
+            close(listen_fd);
+            return;
         }
+        // NOTE(dgl): left over from a server which did not shut down
+        unlink(address.sun_path);
+        close(listen_fd);
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    }
 
-        Sort_Entry *swap_temp = dest;
-        dest = source;
-        source = swap_temp;
+    if (bind(listen_fd, cast(struct sockaddr *, &address), sizeof(address)) != 0 || listen(listen_fd, 16) != 0) {
+        LOG("Failed to listen on %s with error: %d", address.sun_path, errno);
+        close(listen_fd);
+        return;
+    }
+
+    // NOTE(dgl): writers replace the file with a rename, therefore we watch the directory.
+    char directory[MAX_FILENAME_SIZE] = ".";
+    char *basename = ctx->file.filename.text;
+    for (usize index = ctx->file.filename.length; index > 0; --index) {
+        if (ctx->file.filename.text[index - 1] == '/') {
+            string_copy(ctx->file.filename.text, index, directory, MAX_FILENAME_SIZE);
+            basename = ctx->file.filename.text + index;
+            break;
+        }
+    }
+    int watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch_fd >= 0) {
+        inotify_add_watch(watch_fd, directory, IN_MODIFY | IN_MOVED_TO | IN_CREATE | IN_CLOSE_WRITE);
+    }
+
+    // NOTE(dgl): the log gets its own arena, because a reload frees it and the arena of the
+    // caller still holds the commandline.
+    Mem_Arena log_arena = {};
+    if (!mem_arena_reserve(&log_arena, 0, gigabytes(64), "log_arena")) {
+        close(listen_fd);
+        unlink(address.sun_path);
+        if (watch_fd >= 0) {
+            close(watch_fd);
+        }
+        return;
+    }
+
+    Time_Log log = {};
+    File_Generation generation = serve_current_generation(&ctx->file);
+    time_log_load(&log_arena, temp_arena, &ctx->file, &log);
+
+    serve_is_running = true;
+    struct sigaction action = {};
+    action.sa_handler = serve_handle_signal;
+    sigaction(SIGINT, &action, 0);
+    sigaction(SIGTERM, &action, 0);
+    signal(SIGPIPE, SIG_IGN);
+
+    LOG("Serving %s on %s", ctx->file.filename.text, address.sun_path);
+
+    while (serve_is_running) {
+        struct pollfd fds[2] = {};
+        fds[0].fd = listen_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = watch_fd;
+        fds[1].events = POLLIN;
+
+        int ready = poll(fds, watch_fd >= 0 ? 2 : 1, -1);
+        if (ready < 0) {
+            continue;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            bool32 is_our_file = false;
+            char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+            ssize_t length = 0;
+            while ((length = read(watch_fd, events, sizeof(events))) > 0) {
+                for (char *cursor = events; cursor < events + length;) {
+                    struct inotify_event *event = cast(struct inotify_event *, cursor);
+                    if (event->len > 0 && strcmp(event->name, basename) == 0) {
+                        is_our_file = true;
+                    }
+                    cursor += sizeof(struct inotify_event) + event->len;
+                }
+            }
+
+            if (is_our_file) {
+                serve_reload_if_changed(&log_arena, temp_arena, &ctx->file, &log, &generation);
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int client_fd = accept4(listen_fd, 0, 0, SOCK_CLOEXEC);
+            if (client_fd >= 0) {
+                // NOTE(dgl): we serve one client at a time, a client which never closes its
+                // write side must not block the server.
+                struct timeval timeout = {};
+                timeout.tv_sec = SERVE_CLIENT_TIMEOUT_SECONDS;
+                setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+                Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+                serve_handle_request(ctx, client_fd, &log, &generation, &log_arena, tmp_arena.arena);
+                mem_arena_end_temp(tmp_arena);
+                close(client_fd);
+            }
+        }
+    }
+
+    LOG("Shutting down server");
+    mem_arena_release(&log_arena);
+    unlink(address.sun_path);
+    close(listen_fd);
+    if (watch_fd >= 0) {
+        close(watch_fd);
+    }
+}
+
+#if DEBUG
+// NOTE(dgl): starts a server for a temporary time file and sends start, stop, continue and stop
+// to it. The server keeps the log between the requests, the file must keep every line it had
+// and get two new ones.
+internal bool32
+test_serve_start_stop(Mem_Arena *temp_arena) {
+    bool32 result = false;
+
+    char filename[] = "/tmp/ttime_test_XXXXXX";
+    int fd = mkstemp(filename);
+    if (fd < 0) {
+        LOG("Failed to create the test file with error: %d", errno);
+        return result;
+    }
+
+    char *content = "2022-11-21T09:00:00+01:00:00 | 2022-11-21T12:00:00+01:00:00 | 1 | first @test\n"
+                    "2022-11-21T13:00:00+01:00:00 | 2022-11-21T17:00:00+01:00:00 | 2 | second +test\n";
+    usize content_size = string_length(content);
+    bool32 is_written = write(fd, content, content_size) == cast(ssize_t, content_size);
+    close(fd);
+
+    Commandline server = {};
+    server.file = get_file_stats(temp_arena, string_from_c_str(filename));
+
+    pid_t pid = is_written ? fork() : -1;
+    if (pid == 0) {
+        serve_run(&server, temp_arena);
+        _exit(0);
+    } else if (pid > 0) {
+        struct sockaddr_un address;
+        serve_socket_address(&server.file, &address);
+        for (int32 attempt = 0; attempt < 100 && access(address.sun_path, F_OK) != 0; ++attempt) {
+            usleep(10000);
+        }
+
+        char *start[] = {"ttime", "start", "-t", "3", "served", "@test"};
+        char *stop[] = {"ttime", "stop"};
+        char *resume[] = {"ttime", "continue"};
+        result = serve_client_request(&server.file, start, array_count(start)) &&
+                 serve_client_request(&server.file, stop, array_count(stop)) &&
+                 serve_client_request(&server.file, resume, array_count(resume)) &&
+                 serve_client_request(&server.file, stop, array_count(stop));
+
+        kill(pid, SIGTERM);
+        waitpid(pid, 0, 0);
+
+        Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(temp_arena);
+        {
+            File_Stats file = get_file_stats(tmp_arena.arena, string_from_c_str(filename));
+            Buffer buffer = allocate_filebuffer(tmp_arena.arena, &file);
+            read_entire_file(tmp_arena.arena, &file, &buffer);
+
+            usize line_count = 0;
+            for (usize index = 0; index < buffer.data_count; ++index) {
+                line_count += (cast(char *, buffer.data))[index] == '\n';
+            }
+            result = result && line_count == 4 && buffer.data_count > content_size &&
+                     string_compare(content, cast(char *, buffer.data), content_size) == 0;
+            if (!result) {
+                LOG("Server test failed, the file has %lu lines:\n%.*s", line_count, cast(int32, buffer.data_count), cast(char *, buffer.data));
+            }
+        }
+        mem_arena_end_temp(tmp_arena);
     }
+
+    unlink(filename);
+    return result;
 }
+#endif
 
 // TODO(dgl): Help command
 
@@ -1542,220 +6329,313 @@ sort_radix(Sort_Entry *first, Sort_Entry *temp, uint32 entry_count) {
 
 int main(int argc, char** argv) {
     usize begin_cycles = get_rdtsc();
+    global_has_avx2 = __builtin_cpu_supports("avx2");
 
+    // NOTE(dgl): the arenas only reserve address space. Memory is committed when we
+    // allocate it, therefore small commands only touch a few pages.
+    usize reserve_size = gigabytes(64);
 #if DEBUG
     void *base_address = cast(void *, terabytes(2));
 #else
     void *base_address = 0;
 #endif
-    usize memory_size = megabytes(128);
-    uint8 *memory_base = cast(uint8 *, mmap(base_address, memory_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0));
     Mem_Arena permanent_arena = {};
     Mem_Arena transient_arena = {};
 
-    // TODO(dgl): optimize memory for large files
-    mem_arena_init(&permanent_arena, memory_base, megabytes(64), "permanent_arena");
-    mem_arena_init(&transient_arena, memory_base + permanent_arena.size, memory_size - permanent_arena.size, "transient_arena");
+    if (!mem_arena_reserve(&permanent_arena, base_address, reserve_size, "permanent_arena") ||
+        !mem_arena_reserve(&transient_arena, base_address ? cast(uint8 *, base_address) + reserve_size : 0, reserve_size, "transient_arena")) {
+        LOG("Failed to reserve memory");
+        return 1;
+    }
 
     struct timespec start = get_wall_clock();
     Commandline cmdline = {};
     commandline_parse(&permanent_arena, &cmdline, argv, argc);
 
-    if (cmdline.is_valid) {
+    // NOTE(dgl): if a server is running for this file, we let it do the work. -p, -s and -i
+    // describe how to read the file, the server answers from memory. We do not send these
+    // commands to the server and run them ourselves. The server applies -j per request.
+    bool32 is_served = false;
+    if (cmdline.is_valid && cmdline.input_flags == 0 &&
+        (cmdline.command_type == Command_Type_Start ||
+         cmdline.command_type == Command_Type_Stop ||
+         cmdline.command_type == Command_Type_Continue ||
+         cmdline.command_type == Command_Type_Report)) {
+        is_served = serve_client_request(&cmdline.file, argv, argc);
+    }
+
+    if (cmdline.is_valid && !is_served) {
         switch(cmdline.command_type) {
-            // TODO(dgl): almost equal with continue. Can be reduced and refactored
-            case Command_Type_Start: {
-                Buffer buffer = allocate_filebuffer(&permanent_arena, &cmdline.file);
-                read_entire_file(&transient_arena, &cmdline.file, &buffer);
+            case Command_Type_Start:
+            case Command_Type_Continue: {
+                // NOTE(dgl): we only look at the tail of the file and append the new entry.
+                // The cost does not depend on the size of the history.
+                File_Lock lock = file_lock(&transient_arena, &cmdline.file);
+                if (lock.fd < 0) {
+                    break;
+                }
 
-                Tokenizer tokenizer = {};
-                fill_tokenizer(&tokenizer, &buffer);
-                usize last_line_offset = get_last_line_offset(&tokenizer);
-                Entry last_entry = parse_entry_at(&tokenizer, last_line_offset);
+                struct stat before = {};
+                fstat(lock.fd, &before);
 
-                if (!tokenizer.has_error) {
-                    if (last_entry.end.year == 0) {
-                        LOG("Time interval currently active with annotation: %s", string_to_c_str(&transient_arena, last_entry.annotation));
-                    } else {
-                        Entry new_entry = {};
-                        new_entry.begin = get_timestamp();
-                        new_entry.task_id = cmdline.start.task_id;
-                        new_entry.annotation = cmdline.start.annotation;
-                        Buffer entry_buffer = entry_to_buffer(&transient_arena, &new_entry);
-                        write_entire_file(&transient_arena, &cmdline.file, 2, &buffer, &entry_buffer);
-                    }
+                bool32 is_binary = file_is_binary(&cmdline.file);
+                Tokenizer tokenizer = {};
+                Tail_Entry last = {};
+                usize record_count = 0;
+                if (is_binary) {
+                    last = binary_read_last_entry(&permanent_arena, &cmdline.file, &tokenizer, &record_count);
                 } else {
-                    LOG("Tokenizer error: %s", tokenizer.error_msg);
+                    last = tail_read_last_entry(&permanent_arena, &cmdline.file, &tokenizer);
                 }
-            } break;
-            case Command_Type_Continue: {
-                Buffer buffer = allocate_filebuffer(&permanent_arena, &cmdline.file);
-                read_entire_file(&transient_arena, &cmdline.file, &buffer);
-
-                Tokenizer tokenizer = {};
-                fill_tokenizer(&tokenizer, &buffer);
-                usize last_line_offset = get_last_line_offset(&tokenizer);
-                Entry last_entry = parse_entry_at(&tokenizer, last_line_offset);
 
                 if (!tokenizer.has_error) {
-                    if (last_entry.end.year == 0) {
-                        LOG("Time interval currently active with annotation: %s", string_to_c_str(&transient_arena, last_entry.annotation));
+                    if (last.found && last.entry.end.year == 0) {
+                        LOG("Time interval currently active with annotation: %s", string_to_c_str(&transient_arena, last.entry.annotation));
+                    } else if (cmdline.command_type == Command_Type_Continue && !last.found) {
+                        LOG("No time interval to continue");
                     } else {
                         Entry new_entry = {};
-                        new_entry.begin = get_timestamp();
-                        new_entry.task_id = last_entry.task_id;
-                        new_entry.annotation = last_entry.annotation;
-
-                        Buffer entry_buffer = entry_to_buffer(&transient_arena, &new_entry);
-                        write_entire_file(&transient_arena, &cmdline.file, 2, &buffer, &entry_buffer);
+                        new_entry.begin = cmdline.now;
+                        if (cmdline.command_type == Command_Type_Continue) {
+                            new_entry.task_id = last.entry.task_id;
+                            new_entry.annotation = last.entry.annotation;
+                        } else {
+                            new_entry.task_id = cmdline.start.task_id;
+                            new_entry.annotation = cmdline.start.annotation;
+                        }
+                        if (is_binary) {
+                            binary_update(&transient_arena, &cmdline.file, &new_entry, record_count, 1);
+                        } else {
+                            Buffer entry_buffer = entry_to_buffer(&transient_arena, &new_entry);
+
+                            // NOTE(dgl): if the last line has no newline we have to add it.
+                            Buffer newline = {};
+                            if (last.filesize > 0 && !last.ends_with_newline) {
+                                newline.data = "\n";
+                                newline.data_count = 1;
+                                newline.cap = 1;
+                            }
+                            append_to_file(&transient_arena, &cmdline.file, 2, &newline, &entry_buffer);
+                            index_append(&cmdline.file, &before, &new_entry, &newline, &entry_buffer);
+                        }
                     }
                 } else {
                     LOG("Tokenizer error: %s", tokenizer.error_msg);
                 }
+
+                file_unlock(&lock);
             } break;
             case Command_Type_Stop: {
-                Buffer buffer = allocate_filebuffer(&permanent_arena, &cmdline.file);
-                read_entire_file(&transient_arena, &cmdline.file, &buffer);
+                File_Lock lock = file_lock(&transient_arena, &cmdline.file);
+                if (lock.fd < 0) {
+                    break;
+                }
+
+                struct stat before = {};
+                fstat(lock.fd, &before);
 
+                bool32 is_binary = file_is_binary(&cmdline.file);
                 Tokenizer tokenizer = {};
-                fill_tokenizer(&tokenizer, &buffer);
-                usize last_line_offset = get_last_line_offset(&tokenizer);
-                Entry last_entry = parse_entry_at(&tokenizer, last_line_offset);
+                Tail_Entry last = {};
+                usize record_count = 0;
+                if (is_binary) {
+                    last = binary_read_last_entry(&permanent_arena, &cmdline.file, &tokenizer, &record_count);
+                } else {
+                    last = tail_read_last_entry(&permanent_arena, &cmdline.file, &tokenizer);
+                }
 
                 if (!tokenizer.has_error) {
-                    if (last_entry.end.year != 0) {
+                    if (!last.found || last.entry.end.year != 0) {
                         LOG("No time interval active");
+                    } else if (is_binary) {
+                        last.entry.end = cmdline.now;
+                        binary_update(&transient_arena, &cmdline.file, &last.entry, record_count - 1, 1);
                     } else {
-                        last_entry.end = get_timestamp();
-                        Buffer entry_buffer = entry_to_buffer(&transient_arena, &last_entry);
-
-                        // NOTE(dgl): we try to overwrite the last entry in our buffer with the updated info.
-                        // if the space in our buffer is too small we write the data that fits and
-                        // set an offset in our entry_buffer so that we append only the missing bytes
-                        // to the file.
-                        usize missing_bytes = buffer_merge_at(&buffer, &entry_buffer, last_line_offset);
-                        if (missing_bytes > 0) {
-                            usize written = entry_buffer.data_count - missing_bytes;
-                            entry_buffer.data += written;
-                            entry_buffer.data_count -= written;
-                            write_entire_file(&transient_arena, &cmdline.file, 2, &buffer, &entry_buffer);
-                        } else {
-                            write_entire_file(&transient_arena, &cmdline.file, 1, &buffer);
+                        last.entry.end = cmdline.now;
+
+                        bool32 patched = false;
+                        if (last.end_offset > 0) {
+                            // NOTE(dgl): the entry reserved the space for the end time. We
+                            // only overwrite the placeholder.
+                            Buffer end_buffer = datetime_to_buffer(&transient_arena, &last.entry.end);
+                            assert(end_buffer.data_count == DATETIME_CANONICAL_LENGTH, "End time does not fit into the placeholder");
+                            patched = patch_file(&transient_arena, &cmdline.file, last.end_offset, &end_buffer);
+                        }
+
+                        if (!patched) {
+                            // NOTE(dgl): entries without placeholder (older files). We keep everything
+                            // before the last entry and replace the rest of the file with the updated entry.
+                            Buffer entry_buffer = entry_to_buffer(&transient_arena, &last.entry);
+                            rewrite_file(&transient_arena, &cmdline.file, last.offset, &entry_buffer, 1);
                         }
+                        index_close_last(&transient_arena, &cmdline.file, &before, &last.entry, last.offset);
                     }
                 } else {
                     LOG("Tokenizer error: %s", tokenizer.error_msg);
                 }
+
+                file_unlock(&lock);
             } break;
             case Command_Type_Report: {
-                Buffer buffer = allocate_filebuffer(&permanent_arena, &cmdline.file);
-                read_entire_file(&transient_arena, &cmdline.file, &buffer);
-                Tokenizer tokenizer = {};
-                fill_tokenizer(&tokenizer, &buffer);
-
                 usize from_sentinel = datetime_to_epoch(&cmdline.report.from);
                 LOG_DEBUG("From sentinel %lu", from_sentinel);
                 usize to_sentinel = datetime_to_epoch(&cmdline.report.to);
                 LOG_DEBUG("To sentinel %lu", to_sentinel);
 
+                // NOTE(dgl): in stream mode the table keeps a copy of the annotations of the
+                // matching entries. Otherwise the annotations point directly into the mapping.
+                bool32 is_stream = (cmdline.input_flags & Input_Stream) != 0;
+                bool32 is_binary = file_is_binary(&cmdline.file);
+                Entry_Table table = {};
+                Buffer buffer = {};
+                bool32 is_mapped = false;
+                Tokenizer tokenizer = {};
 
-                uint32 entry_count = 0;
-                uint32 max_entry_count = 100;
-                EntryMeta *entries = mem_arena_push_array(&transient_arena, EntryMeta, max_entry_count);
-                while(!tokenizer.has_error && tokenizer.input.length > 0) {
-                    EntryMeta meta = parse_entry_meta(&tokenizer);
-                    eat_all_whitespace(&tokenizer);
+                // NOTE(dgl): If the index cannot answer the report we parse the text.
+                bool32 has_tags = report_needs_tags(&cmdline);
+                bool32 is_indexed = false;
+                if (!is_stream && !is_binary && ((cmdline.input_flags & Input_Index) || index_is_preferred(&cmdline.file, from_sentinel, to_sentinel))) {
+                    Time_Index index = {};
+                    table.has_tags = has_tags;
+                    is_indexed = index_open(&permanent_arena, &transient_arena, &cmdline.file, &index) &&
+                                 index_fill_table(&permanent_arena, &cmdline, &index, from_sentinel, to_sentinel, &table);
+                    if (!is_indexed) {
+                        table = (Entry_Table){};
+                    }
+                    index_close(&index);
+                }
 
-                    if (meta.begin > from_sentinel && meta.begin < to_sentinel) {
-                        if (entry_count == max_entry_count) {
-                            usize current_count = max_entry_count;
-                            max_entry_count *= 2;
-                            entries = mem_arena_resize_array(&transient_arena, EntryMeta, entries, current_count, max_entry_count);
+                // NOTE(dgl): we do not lock the file. If a writer replaced the file (or changed
+                // it while we failed to parse it) we read it again.
+                for (int32 attempt = 0; !is_indexed && attempt < FILE_READ_RETRIES; ++attempt) {
+                    File_Generation generation = {};
+                    tokenizer = (Tokenizer){};
+                    table = (Entry_Table){};
+                    table.has_tags = has_tags;
+
+                    if (is_binary) {
+                        // NOTE(dgl): the annotations of the table point into the pool of the mapping
+                        is_mapped = map_entire_file(&transient_arena, &cmdline.file, &buffer, cmdline.input_flags, &generation);
+                        Binary_Log log = {};
+                        if (binary_from_buffer(&buffer, &log)) {
+                            binary_fill_table(&transient_arena, &log, from_sentinel, to_sentinel, &table);
+                        } else {
+                            tokenizer.has_error = true;
+                            stbsp_snprintf(tokenizer.error_msg, sizeof(tokenizer.error_msg), "Invalid binary time file");
                         }
+                    } else if (is_stream) {
+                        report_stream_entries(&cmdline, &permanent_arena, &transient_arena, from_sentinel, to_sentinel, &table, &tokenizer, &generation);
+                    } else {
+                        is_mapped = map_entire_file(&transient_arena, &cmdline.file, &buffer, cmdline.input_flags, &generation);
+                        if (!is_mapped) {
+                            struct stat file_stat = {};
+                            if (stat(cmdline.file.filename.text, &file_stat) == 0) {
+                                generation = file_generation_from_stat(&file_stat);
+                                cmdline.file.filesize = cast(usize, file_stat.st_size);
+                            }
+                            buffer = allocate_filebuffer(&permanent_arena, &cmdline.file);
+                            read_entire_file(&transient_arena, &cmdline.file, &buffer);
+                        }
+                        fill_tokenizer(&tokenizer, &buffer);
+                        usize window_begin = 0;
+                        usize window_end = buffer.data_count;
+                        bool32 is_ordered = buffer.data_count >= RANGE_SEEK_MIN_SIZE && index_is_ordered(&cmdline.file, &buffer);
+                        range_seek(&buffer, is_ordered, from_sentinel, to_sentinel, &window_begin, &window_end);
+                        parse_entries(&transient_arena, &buffer, window_begin, window_end, from_sentinel, to_sentinel, cmdline.thread_count, &table, &tokenizer);
+                    }
 
-                        entries[entry_count++] = meta;
+                    int32 changed = file_generation_changed(&cmdline.file, &generation);
+                    if ((changed & File_Changed_Replaced) || (changed && tokenizer.has_error)) {
+                        LOG_DEBUG("File changed while reading (%d). Retrying", changed);
+                        if (is_mapped) {
+                            unmap_file(&buffer);
+                            is_mapped = false;
+                        }
+                        continue;
                     }
+                    break;
                 }
 
                 if (tokenizer.has_error) {
                     LOG("Tokenizer error: %s", tokenizer.error_msg);
                 }
 
-                if (entry_count > 0) {
-                    // NOTE(dgl): use different memory layout if too slow. @performance
-                    Sort_Entry *sort_entries = mem_arena_push_array(&permanent_arena, Sort_Entry, entry_count);
-                    for (int32 index = 0; index < entry_count; ++index) {
-                        Sort_Entry *sort = sort_entries + index;
-                        EntryMeta *meta = entries + index;
-
-                        // NOTE(dgl): @performance we could also use an offset of now to be able to use 32bit integers.
-                        // This would decrease the passes on the radix sort. It should be fine with the offset, because
-                        // the seconds of one year do not surpass a 32bit integer
-
-                        assert(from_sentinel < meta->begin, "begin cannot be in the future, for sorting");
-                        sort->sort_key = cast(uint32, meta->begin - from_sentinel);
-                        sort->index = index;
-                    }
-
-                    Mem_Temp_Arena tmp_arena = mem_arena_begin_temp(&transient_arena);
-                    {
-                        Sort_Entry *sort_memory = mem_arena_push_array(tmp_arena.arena, Sort_Entry, entry_count);
-                        sort_radix(sort_entries, sort_memory, entry_count);
-                    }
-                    mem_arena_end_temp(tmp_arena);
-
-#if DEBUG
-                     for (int32 index = 0; index < entry_count - 1; ++index) {
-                        Sort_Entry *a = sort_entries + index;
-                        Sort_Entry *b = a + 1;
-
-                        assert(a->sort_key <= b->sort_key, "Array not correctly sorted at index %d - a: %d, b: %d", index, a->sort_key, b->sort_key);
-                    }
-#endif
-
-                    usize total_seconds = 0;
-                    usize daily_seconds = 0;
-                    int32 last_day = 0;
-                    // TODO(dgl): use info from entry array to determine what is printed
-                    int32 print_flags = Print_Timezone;
-                    for (int32 index = 0; index < entry_count; ++index) {
-                        EntryMeta *meta = entries + sort_entries[index].index;
-
-                        Entry entry = parse_entry_from_meta(&tokenizer, meta);
-
-                        if (report_tag_matches(&cmdline, &entry)) {
-                            if (entry.end.year == 0) { entry.end = get_timestamp(); }
-                            usize end = datetime_to_epoch(&entry.end);
-                            assert(meta->begin < end, "End time cannot be larger than begin time");
-                            usize difftime = end - meta->begin;
-
-                            total_seconds += difftime;
-
-                            if (entry.begin.day != last_day && last_day > 0) {
-                                print_datetime(&transient_arena, print_flags, "\t\t%th hs\n", daily_seconds);
-                                daily_seconds = 0;
+                Report_Printer printer = {};
+                printer.arena = &transient_arena;
+                printer.now = cmdline.now;
+                // TODO(dgl): use info from entry array to determine what is printed
+                printer.print_flags = Print_Timezone;
+                printer.is_flat = cmdline.report.sort != Report_Sort_Begin;
+
+                uint32 entry_count = cast(uint32, table.count);
+                if (entry_count > 0 && cmdline.report.group_by != Report_Group_None) {
+                    Tag_Filter filter = report_tag_filter(&permanent_arena, &cmdline, &table);
+                    report_print_groups(&transient_arena, &cmdline, &table, &filter);
+                } else if (entry_count > 0) {
+                    Sort_Entry *sort_entries = report_sort_table(&permanent_arena, &transient_arena, &table, cmdline.report.sort, from_sentinel, &cmdline.now, cmdline.thread_count);
+
+                    Tag_Filter filter = report_tag_filter(&permanent_arena, &cmdline, &table);
+                    for (uint32 index = 0; index < entry_count; ++index) {
+                        usize entry_index = cast(usize, sort_entries[index].index);
+
+                        if (entry_table_tags_match(&table, &filter, entry_index)) {
+                            Datetime begin = epoch_to_datetime(table.begins[entry_index], table.begin_offsets[entry_index]);
+                            Datetime end = {};
+                            if (!table.is_open[entry_index]) {
+                                end = epoch_to_datetime(table.ends[entry_index], table.end_offsets[entry_index]);
                             }
-
-                            if (daily_seconds == 0) {
-                                print_datetime(&transient_arena, print_flags, "%td\t", entry.begin);
-                            }
-
-                            daily_seconds += difftime;
-                            last_day = entry.begin.day;
-
-                            print_datetime(&transient_arena, print_flags, "\n\t%tt - %tt => \t %th hs", entry.begin, entry.end, difftime, entry.annotation);
+                            report_print_entry(&printer, table.begins[entry_index], &begin, &end);
                         }
                     }
 
-                    print_datetime(&transient_arena, print_flags, "\t\t%th hs\n\n", daily_seconds);
-                    print_datetime(&transient_arena, print_flags, "Total hours: %th hs\n", total_seconds);
+                    report_print_total(&printer);
                 } else {
                     LOG("No entry found.");
                 }
+
+                if (is_mapped) {
+                    unmap_file(&buffer);
+                }
             } break;
             case Command_Type_CSV: {
                 LOG("Not yet implemented");
             } break;
+            case Command_Type_Batch: {
+                batch_run(&cmdline, &permanent_arena, &transient_arena);
+            } break;
+            case Command_Type_Serve: {
+                serve_run(&cmdline, &transient_arena);
+            } break;
+            case Command_Type_Import: {
+                // NOTE(dgl): we never overwrite entries. The file has to be empty or new.
+                File_Stats source = get_file_stats(&permanent_arena, cmdline.convert.filename);
+                File_Lock lock = {};
+                lock.fd = -1;
+                if (cmdline.file.exists) {
+                    lock = file_lock(&transient_arena, &cmdline.file);
+                }
+
+                Time_Log log = {};
+                if (cmdline.file.exists && cmdline.file.filesize > 0) {
+                    LOG("File %s is not empty", string_to_c_str(&transient_arena, cmdline.file.filename));
+                } else if (!source.exists) {
+                    LOG("File %s does not exist", string_to_c_str(&transient_arena, source.filename));
+                } else if (time_log_load(&permanent_arena, &transient_arena, &source, &log)) {
+                    time_log_write(&transient_arena, &cmdline.file, &log);
+                    LOG("Imported %u entries", log.count);
+                }
+                file_unlock(&lock);
+            } break;
+            case Command_Type_Export: {
+                File_Stats dest = get_file_stats(&permanent_arena, cmdline.convert.filename);
+                Time_Log log = {};
+                if (dest.exists && dest.filesize > 0) {
+                    LOG("File %s is not empty", string_to_c_str(&transient_arena, dest.filename));
+                } else if (time_log_load(&permanent_arena, &transient_arena, &cmdline.file, &log)) {
+                    time_log_write(&transient_arena, &dest, &log);
+                    LOG("Exported %u entries", log.count);
+                }
+            } break;
     #if DEBUG
             case Command_Type_Generate: {
                 LOG("Not yet implemented");
@@ -1765,13 +6645,17 @@ int main(int argc, char** argv) {
                 Entry entry = {};
                 entry.annotation = annotation;
 
-                LOG_DEBUG("Tag match: %d", report_tag_matches(&cmdline, &entry));
+                LOG_DEBUG("Tag match: %d", report_tag_matches(&cmdline, entry.annotation));
+                LOG("Server start/stop: %s", test_serve_start_stop(&transient_arena) ? "ok" : "failed");
+            } break;
+            case Command_Type_Bench: {
+                sort_bench(&transient_arena);
             } break;
     #endif
             default:
                 LOG_DEBUG("Command type %d not implemented", cmdline.command_type);
         }
-    } else {
+    } else if (!is_served) {
         LOG("Invalid arguments");
     }
 